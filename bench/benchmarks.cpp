@@ -0,0 +1,253 @@
+#include "hash_map.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The containers are compared on the same operations and keys: every size is a number of
+// elements, from a table fitting L1 up to about OAH_BENCH_MAX_BYTES of memory.
+
+#ifndef OAH_BENCH_MAX_BYTES
+#define OAH_BENCH_MAX_BYTES (std::size_t(1) << 30)
+#endif
+
+namespace {
+
+constexpr std::size_t min_bytes = std::size_t(32) << 10;
+
+// a bijection on 64-bit values, so that distinct indices give distinct keys
+std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+template<class K>
+struct KeyMaker;
+
+template<>
+struct KeyMaker<std::uint32_t> {
+    static constexpr std::size_t heap_bytes = 0;
+
+    static std::uint32_t make(std::uint64_t i) {
+        // the low half of a bijection is no bijection, a multiplication by an odd constant is
+        return static_cast<std::uint32_t>(i) * 0x9E3779B1u;
+    }
+};
+
+template<>
+struct KeyMaker<std::uint64_t> {
+    static constexpr std::size_t heap_bytes = 0;
+
+    static std::uint64_t make(std::uint64_t i) {
+        return mix(i);
+    }
+};
+
+template<std::size_t Length>
+struct StringKey {
+    static constexpr std::size_t heap_bytes = Length > 15 ? Length + 1 : 0;
+
+    static std::string make(std::uint64_t i) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string res(Length, '-');
+        std::uint64_t x = mix(i);
+        for (std::size_t j = 0; j < 16 && j < Length; ++j, x >>= 4) {
+            res[Length - 1 - j] = digits[x & 15];
+        }
+        return res;
+    }
+};
+
+// short strings fit the small string buffer, long ones are allocated
+struct ShortString : StringKey<12> {
+};
+
+struct LongString : StringKey<48> {
+};
+
+template<class Maker>
+using key_of_maker = decltype(Maker::make(0));
+
+// keys [0, n) are inserted, keys [n, 2n) are known to be absent
+template<class Maker>
+std::vector<key_of_maker<Maker>> make_keys(std::size_t from, std::size_t n) {
+    std::vector<key_of_maker<Maker>> keys;
+    keys.reserve(n);
+    for (std::size_t i = from; i < from + n; ++i) {
+        keys.push_back(Maker::make(i));
+    }
+    return keys;
+}
+
+template<class Map, class Maker>
+Map make_map(const std::vector<key_of_maker<Maker>> &keys) {
+    Map map;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        map.emplace(keys[i], i);
+    }
+    return map;
+}
+
+template<class Map, class Maker>
+void bm_insert(benchmark::State &state) {
+    const auto keys = make_keys<Maker>(0, static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        Map map;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            map.emplace(keys[i], i);
+        }
+        benchmark::DoNotOptimize(map);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<class Map, class Maker>
+void bm_find_hit(benchmark::State &state) {
+    const std::size_t n = static_cast<std::size_t>(state.range(0));
+    const auto keys = make_keys<Maker>(0, n);
+    const Map map = make_map<Map, Maker>(keys);
+    // lookups in an order unrelated to the insertion one
+    std::vector<std::size_t> order(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        order[i] = mix(i) % n;
+    }
+    for (auto _ : state) {
+        std::size_t sum = 0;
+        for (std::size_t i : order) {
+            sum += map.find(keys[i])->second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<class Map, class Maker>
+void bm_find_miss(benchmark::State &state) {
+    const std::size_t n = static_cast<std::size_t>(state.range(0));
+    const Map map = make_map<Map, Maker>(make_keys<Maker>(0, n));
+    const auto missing = make_keys<Maker>(n, n);
+    for (auto _ : state) {
+        std::size_t found = 0;
+        for (const auto &key : missing) {
+            found += map.find(key) != map.end();
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// a window of n keys slides over 2n of them: every step erases the oldest and inserts a new one
+template<class Map, class Maker>
+void bm_erase_churn(benchmark::State &state) {
+    const std::size_t n = static_cast<std::size_t>(state.range(0));
+    const auto keys = make_keys<Maker>(0, 2 * n);
+    Map map;
+    for (std::size_t i = 0; i < n; ++i) {
+        map.emplace(keys[i], i);
+    }
+    std::size_t oldest = 0;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < n; ++i) {
+            map.erase(keys[oldest]);
+            map.emplace(keys[(oldest + n) % keys.size()], i);
+            oldest = (oldest + 1) % keys.size();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<class Map, class Maker>
+void bm_iterate(benchmark::State &state) {
+    const Map map = make_map<Map, Maker>(make_keys<Maker>(0, static_cast<std::size_t>(state.range(0))));
+    for (auto _ : state) {
+        std::size_t sum = 0;
+        for (const auto &value : map) {
+            sum += value.second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// growing a table of n elements to room for 2n, the copy is not timed
+template<class Map, class Maker>
+void bm_rehash(benchmark::State &state) {
+    const std::size_t n = static_cast<std::size_t>(state.range(0));
+    const Map map = make_map<Map, Maker>(make_keys<Maker>(0, n));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Map copy = map;
+        state.ResumeTiming();
+        copy.reserve(2 * n);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Element counts from one fitting min_bytes to one taking about OAH_BENCH_MAX_BYTES, growing
+// eight times at each step. The footprint guess covers the slot array at half load.
+template<class Map, class Maker>
+void set_sizes(benchmark::internal::Benchmark *bench) {
+    const std::size_t footprint = 2 * (sizeof(typename Map::value_type) + 2 * sizeof(std::size_t) + 1) +
+                                  Maker::heap_bytes;
+    std::size_t n = std::max<std::size_t>(min_bytes / footprint, 8);
+    for (; n * footprint <= OAH_BENCH_MAX_BYTES; n *= 8) {
+        bench->Arg(static_cast<std::int64_t>(n));
+    }
+}
+
+template<class Map, class Maker>
+void register_map(const std::string &map_name, const std::string &key_name) {
+    const std::string suffix = "<" + map_name + ", " + key_name + ">";
+    const struct {
+        const char *name;
+        void (*run)(benchmark::State &);
+    } benchmarks[] = {
+            {"insert", bm_insert<Map, Maker>},
+            {"find_hit", bm_find_hit<Map, Maker>},
+            {"find_miss", bm_find_miss<Map, Maker>},
+            {"erase_churn", bm_erase_churn<Map, Maker>},
+            {"iterate", bm_iterate<Map, Maker>},
+            {"rehash", bm_rehash<Map, Maker>},
+    };
+    for (const auto &b : benchmarks) {
+        auto *bench = benchmark::RegisterBenchmark((b.name + suffix).c_str(), b.run);
+        set_sizes<Map, Maker>(bench);
+        bench->Unit(benchmark::kMicrosecond);
+    }
+}
+
+template<class Maker>
+void register_key(const std::string &key_name) {
+    using Key = key_of_maker<Maker>;
+    register_map<HashMap<Key, std::size_t, LinearProbing>, Maker>("LinearProbing", key_name);
+    register_map<HashMap<Key, std::size_t, QuadraticProbing>, Maker>("QuadraticProbing", key_name);
+    register_map<std::unordered_map<Key, std::size_t>, Maker>("std::unordered_map", key_name);
+}
+
+} // namespace
+
+// Run through the run_benchmarks target to get the results as JSON, or pass
+// --benchmark_out=<file> --benchmark_out_format=json.
+int main(int argc, char **argv) {
+    register_key<KeyMaker<std::uint32_t>>("uint32");
+    register_key<KeyMaker<std::uint64_t>>("uint64");
+    register_key<ShortString>("short_string");
+    register_key<LongString>("long_string");
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
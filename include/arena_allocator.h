@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Memory pool for containers which keep allocating and freeing blocks of similar sizes.
+// A request is rounded up to a power of two size class, a freed block goes to the freelist
+// of its class and is handed out again without calling the system allocator. Blocks of up
+// to slab_size / 8 bytes are carved from slabs, larger ones are allocated one by one.
+// Memory returns to the system only when the arena is destroyed. Not thread safe.
+class SlabArena {
+public:
+    static constexpr std::size_t slab_size = 64 * 1024;
+
+    // every block is aligned at least this much
+    static constexpr std::size_t alignment = 16;
+
+    SlabArena() = default;
+
+    SlabArena(const SlabArena &) = delete;
+
+    SlabArena &operator=(const SlabArena &) = delete;
+
+    ~SlabArena() {
+        for (void *chunk : m_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void *allocate(std::size_t bytes) {
+        const unsigned cls = size_class(bytes);
+        if (FreeBlock *block = m_free[cls]) {
+            m_free[cls] = block->next;
+            return block;
+        }
+        const std::size_t size = std::size_t(1) << cls;
+        if (size > slab_size / 8) {
+            return new_chunk(size);
+        }
+        if (m_slab_left < size) {
+            // what is left of the current slab is dropped, it is less than 1/8 of it
+            m_slab_pos = static_cast<char *>(new_chunk(slab_size));
+            m_slab_left = slab_size;
+        }
+        void *res = m_slab_pos;
+        m_slab_pos += size;
+        m_slab_left -= size;
+        return res;
+    }
+
+    void deallocate(void *p, std::size_t bytes) noexcept {
+        if (p == nullptr) {
+            return;
+        }
+        const unsigned cls = size_class(bytes);
+        auto *block = static_cast<FreeBlock *>(p);
+        block->next = m_free[cls];
+        m_free[cls] = block;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    static constexpr unsigned min_class = 4;
+
+    static_assert((std::size_t(1) << min_class) >= alignment && alignment >= alignof(FreeBlock),
+                  "the smallest block must keep the alignment");
+
+    FreeBlock *m_free[std::numeric_limits<std::size_t>::digits] = {};
+    std::vector<void *> m_chunks;
+    char *m_slab_pos = nullptr;
+    std::size_t m_slab_left = 0;
+
+    static unsigned size_class(std::size_t bytes) {
+        // past the largest power of two there is no class and the shift below would overflow
+        if (bytes > (std::size_t(1) << (std::numeric_limits<std::size_t>::digits - 1))) {
+            throw std::bad_alloc();
+        }
+        unsigned cls = min_class;
+        while ((std::size_t(1) << cls) < bytes) {
+            ++cls;
+        }
+        return cls;
+    }
+
+    void *new_chunk(std::size_t size) {
+        m_chunks.reserve(m_chunks.size() + 1);
+        void *chunk = ::operator new(size);
+        m_chunks.push_back(chunk);
+        return chunk;
+    }
+};
+
+// Standard allocator handing out memory of a SlabArena owned by the user, which must outlive
+// every container using it. Containers sharing an arena exchange memory freely, so the
+// allocator propagates on copy, move and swap.
+template<class T>
+class ArenaAllocator {
+    template<class U>
+    friend class ArenaAllocator;
+
+    static_assert(alignof(T) <= SlabArena::alignment, "SlabArena does not support over-aligned types");
+
+    SlabArena *m_arena;
+
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    explicit ArenaAllocator(SlabArena &arena) noexcept : m_arena(&arena) {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : m_arena(other.m_arena) {}
+
+    T *allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        m_arena->deallocate(p, n * sizeof(T));
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept {
+        return m_arena == other.m_arena;
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &other) const noexcept {
+        return m_arena != other.m_arena;
+    }
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include "hash_table.h"
+#include "policy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+// Map safe for concurrent use: keys are partitioned across independent shards, each being an
+// open addressing table behind its own reader/writer lock, so operations on different shards
+// never contend and a shard grows without blocking the others. The shard is chosen by the high
+// bits of the remixed hash, the table inside the shard reuses the same hash value.
+// Since elements may move on any insert or erase, access goes through copies and callbacks
+// run under the shard lock instead of iterators and references.
+template<
+        class Key,
+        class T,
+        class CollisionPolicy = LinearProbing,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<std::pair<const Key, T>>
+>
+class ConcurrentHashMap {
+
+    struct KeyOf {
+        static const Key &get(const std::pair<const Key, T> &value) {
+            return value.first;
+        }
+    };
+
+    using Table = HashTable<Key, std::pair<const Key, T>, KeyOf, CollisionPolicy, guarded_hash_t<Hash>, Equal, Reducer, GrowthPolicy, Allocator>;
+
+    static constexpr std::size_t npos = Table::npos;
+
+    // own cache line for every shard, otherwise taking one lock would invalidate its neighbours
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        Table table;
+
+        Shard(std::size_t expected_max_size, const guarded_hash_t<Hash> &hash, const Equal &equal, const Allocator &alloc)
+                : table(expected_max_size, hash, equal, alloc) {}
+    };
+
+public:
+    // types
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+
+    // four shards per hardware thread; shard counts are rounded up to a power of two
+    static size_type default_shard_count() {
+        return std::max<size_type>(4 * std::thread::hardware_concurrency(), 1);
+    }
+
+    explicit ConcurrentHashMap(size_type shard_count = default_shard_count(),
+                               size_type expected_max_size = 0,
+                               const hasher &hash = hasher(),
+                               const key_equal &equal = key_equal(),
+                               const allocator_type &alloc = allocator_type()) : m_hash(hash) {
+        while ((size_type(1) << m_shard_bits) < shard_count) {
+            ++m_shard_bits;
+        }
+        const size_type count = size_type(1) << m_shard_bits;
+        m_shards = std::allocator<Shard>().allocate(count);
+        try {
+            for (; m_shard_count < count; ++m_shard_count) {
+                new(&m_shards[m_shard_count]) Shard((expected_max_size + count - 1) / count, hash, equal, alloc);
+            }
+        } catch (...) {
+            destroy_shards();
+            throw;
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap &) = delete;
+
+    ConcurrentHashMap &operator=(const ConcurrentHashMap &) = delete;
+
+    ~ConcurrentHashMap() {
+        destroy_shards();
+    }
+
+    size_type shard_count() const {
+        return m_shard_count;
+    }
+
+    // a snapshot which may be outdated by the time it is returned
+    size_type size() const {
+        size_type res = 0;
+        for (size_type i = 0; i < m_shard_count; ++i) {
+            std::shared_lock lock(m_shards[i].mutex);
+            res += m_shards[i].table.size();
+        }
+        return res;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void clear() {
+        for (size_type i = 0; i < m_shard_count; ++i) {
+            std::unique_lock lock(m_shards[i].mutex);
+            m_shards[i].table.clear();
+        }
+    }
+
+    void reserve(size_type count) {
+        for (size_type i = 0; i < m_shard_count; ++i) {
+            std::unique_lock lock(m_shards[i].mutex);
+            m_shards[i].table.rehash((count + m_shard_count - 1) / m_shard_count);
+        }
+    }
+
+    bool insert(const value_type &value) {
+        return emplace_impl(value.first, value);
+    }
+
+    bool insert(value_type &&value) {
+        return emplace_impl(value.first, std::move(value));
+    }
+
+    template<class... Args>
+    bool emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    bool try_emplace(const key_type &key, Args &&... args) {
+        return emplace_impl(key, std::piecewise_construct,
+                            std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    bool try_emplace(key_type &&key, Args &&... args) {
+        return emplace_impl(key, std::piecewise_construct,
+                            std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class M>
+    bool insert_or_assign(const key_type &key, M &&value) {
+        return assign_impl(key, std::forward<M>(value));
+    }
+
+    template<class M>
+    bool insert_or_assign(key_type &&key, M &&value) {
+        return assign_impl(std::move(key), std::forward<M>(value));
+    }
+
+    size_type erase(const key_type &key) {
+        const size_type hash = m_hash(key);
+        Shard &shard = shard_for(hash);
+        std::unique_lock lock(shard.mutex);
+        const size_type idx = shard.table.find_index(key, hash);
+        if (idx == npos) {
+            return 0;
+        }
+        shard.table.erase_by_idx(idx);
+        return 1;
+    }
+
+    size_type count(const key_type &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    bool contains(const key_type &key) const {
+        return cvisit(key, [](const mapped_type &) {});
+    }
+
+    // a copy of the mapped value
+    std::optional<mapped_type> get(const key_type &key) const {
+        std::optional<mapped_type> res;
+        cvisit(key, [&res](const mapped_type &value) {
+            res.emplace(value);
+        });
+        return res;
+    }
+
+    // calls f with the mapped value of key under the exclusive lock of its shard;
+    // returns false if the key is absent
+    template<class F>
+    bool visit(const key_type &key, F f) {
+        const size_type hash = m_hash(key);
+        Shard &shard = shard_for(hash);
+        std::unique_lock lock(shard.mutex);
+        const size_type idx = shard.table.find_index(key, hash);
+        if (idx == npos) {
+            return false;
+        }
+        f(shard.table.value_at(idx).second);
+        return true;
+    }
+
+    // the same under the shared lock, f receives a const reference
+    template<class F>
+    bool cvisit(const key_type &key, F f) const {
+        const size_type hash = m_hash(key);
+        const Shard &shard = shard_for(hash);
+        std::shared_lock lock(shard.mutex);
+        const size_type idx = shard.table.find_index(key, hash);
+        if (idx == npos) {
+            return false;
+        }
+        f(shard.table.value_at(idx).second);
+        return true;
+    }
+
+    // calls f for every element, holding the shared lock of one shard at a time
+    template<class F>
+    void for_each(F f) const {
+        for (size_type i = 0; i < m_shard_count; ++i) {
+            std::shared_lock lock(m_shards[i].mutex);
+            for (const value_type &value : m_shards[i].table) {
+                f(value);
+            }
+        }
+    }
+
+private:
+    Shard *m_shards = nullptr;
+    size_type m_shard_count = 0;
+    unsigned m_shard_bits = 0;
+    hasher m_hash;
+
+    // The tables take their home slot from the hash as is, so the shard index must not be a
+    // plain function of the same bits: with FibonacciReducer every key of a shard would share
+    // the top bits of its home slot. The murmur3 finalizer decorrelates the two.
+    size_type shard_index(size_type hash) const {
+        if (m_shard_bits == 0) {
+            return 0;
+        }
+        std::uint64_t h = hash;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return static_cast<size_type>(h >> (64 - m_shard_bits));
+    }
+
+    void destroy_shards() {
+        for (size_type i = 0; i < m_shard_count; ++i) {
+            m_shards[i].~Shard();
+        }
+        std::allocator<Shard>().deallocate(m_shards, size_type(1) << m_shard_bits);
+    }
+
+    Shard &shard_for(size_type hash) {
+        return m_shards[shard_index(hash)];
+    }
+
+    const Shard &shard_for(size_type hash) const {
+        return m_shards[shard_index(hash)];
+    }
+
+    template<class... Args>
+    bool emplace_impl(const key_type &key, Args &&... args) {
+        const size_type hash = m_hash(key);
+        Shard &shard = shard_for(hash);
+        std::unique_lock lock(shard.mutex);
+        return shard.table.emplace_with_hash(npos, key, hash, std::forward<Args>(args)...).second;
+    }
+
+    template<class K, class M>
+    bool assign_impl(K &&key, M &&value) {
+        const size_type hash = m_hash(key);
+        Shard &shard = shard_for(hash);
+        std::unique_lock lock(shard.mutex);
+        auto res = shard.table.emplace_with_hash(npos, key, hash, std::forward<K>(key), std::forward<M>(value));
+        if (!res.second) {
+            shard.table.value_at(res.first).second = std::forward<M>(value);
+        }
+        return res.second;
+    }
+};
@@ -0,0 +1,549 @@
+#pragma once
+
+#include "group.h"
+#include "hashers.h"
+#include "policy.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Set with lock free lookups for read dominated workloads. Every slot has an atomic control
+// word holding its state and the 7-bit tag of its key; an insert claims an empty slot with a
+// CAS, constructs the key and only then publishes the slot as full, so readers never see a
+// key under construction. Keys are never moved: an erased key leaves a tombstone and a resize
+// copies the live keys into a new table. The resize is cooperative but not incremental for
+// writers: every writer that finds one in progress helps migrating chunks of the old table,
+// then blocks until the whole table is migrated. A chunk whose copy throws is handed back to
+// be retried by the next writer. Readers never wait: a frozen slot keeps the state it had when
+// it was migrated, so they finish their lookup in the table they started in, which holds
+// every key inserted before the lookup began.
+// A retired table, with the erased keys it holds, is freed by the next write made outside of
+// any other operation of the set, once no operation which started before its retirement is
+// left: every operation registers in the counters of the current epoch, and the reclaiming
+// writer advances the epoch and waits for the counters of the previous one to drain. Churn
+// thus keeps about two tables alive, the current one and the one being migrated. Linear
+// probing with Fibonacci hashing over power of two capacities.
+template<
+        class Key,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>
+>
+class ConcurrentHashSet {
+    using ctrl_word = std::uint16_t;
+
+    // state in the high byte, hash tag in the low one
+    enum State : ctrl_word {
+        EMPTY = 0,
+        BUSY = 1,       // claimed by an insert, the key is being constructed
+        FULL = 2,
+        DELETED = 3,    // erased, the key stays alive
+        FROZEN = 4,         // migrated, never held a key
+        FROZEN_KEY = 5,     // migrated while full, holds a key
+        ABANDONED = 6,      // the key constructor threw, a tombstone without a key
+        FROZEN_DELETED = 7, // migrated while erased, the key stays alive
+        MIGRATING = 8       // full, the key is being copied to the new table
+    };
+
+    static constexpr ctrl_word word(State state, ctrl_t tag) {
+        return static_cast<ctrl_word>((state << 8) | static_cast<unsigned char>(tag));
+    }
+
+    static bool is_frozen(State state) {
+        return state == FROZEN || state == FROZEN_KEY || state == FROZEN_DELETED || state == MIGRATING;
+    }
+
+    static State state_of(ctrl_word w) {
+        return static_cast<State>(w >> 8);
+    }
+
+    static ctrl_t tag_of(ctrl_word w) {
+        return static_cast<ctrl_t>(w & 0xFF);
+    }
+
+    struct Slot {
+        std::atomic<ctrl_word> ctrl;
+        alignas(Key) unsigned char storage[sizeof(Key)];
+
+        const Key &key() const {
+            return *std::launder(reinterpret_cast<const Key *>(storage));
+        }
+    };
+
+    struct Table {
+        const std::size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+        // slots ever claimed, tombstones included
+        std::atomic<std::size_t> used{0};
+        std::atomic<Table *> next{nullptr};
+        // migration progress: chunks being or done migrating, and slots frozen
+        std::unique_ptr<std::atomic<bool>[]> claimed;
+        std::atomic<std::size_t> migrated{0};
+        // link of the list of retired tables
+        Table *retired_next = nullptr;
+
+        explicit Table(std::size_t slot_count)
+                : capacity(slot_count), slots(new Slot[slot_count]()), claimed(new std::atomic<bool>[chunk_count(slot_count)]()) {}
+
+        ~Table() {
+            for (std::size_t i = 0; i < capacity; ++i) {
+                const State state = state_of(slots[i].ctrl.load(std::memory_order_relaxed));
+                if (state == FULL || state == DELETED || state == FROZEN_KEY || state == FROZEN_DELETED ||
+                    state == MIGRATING) {
+                    slots[i].key().~Key();
+                }
+            }
+        }
+    };
+
+    // operations in progress which started in an epoch of the same parity, split over cache
+    // lines so that readers on different threads do not contend
+    struct alignas(64) OperationCount {
+        std::atomic<std::size_t> value{0};
+    };
+
+    static constexpr std::size_t operation_stripes = 16;
+
+    // registers an operation for its lifetime, retired tables are not freed until it is over
+    class Guard {
+    public:
+        explicit Guard(const ConcurrentHashSet &set) : m_count(set.enter()) {
+            ++guard_depth();
+        }
+
+        Guard(const Guard &) = delete;
+
+        Guard &operator=(const Guard &) = delete;
+
+        ~Guard() {
+            --guard_depth();
+            m_count.fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<std::size_t> &m_count;
+    };
+
+    enum class Result {
+        INSERTED,
+        PRESENT,
+        FROZEN
+    };
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+
+    static constexpr float max_load_factor = 0.5f;
+
+    explicit ConcurrentHashSet(size_type expected_max_size = 0,
+                               const hasher &hash = hasher(),
+                               const key_equal &equal = key_equal()) : m_hash(hash), m_equal(equal) {
+        size_type capacity = 16;
+        while (static_cast<float>(expected_max_size) > max_load_factor * static_cast<float>(capacity)) {
+            capacity <<= 1;
+        }
+        m_current.store(new Table(capacity), std::memory_order_release);
+    }
+
+    ConcurrentHashSet(const ConcurrentHashSet &) = delete;
+
+    ConcurrentHashSet &operator=(const ConcurrentHashSet &) = delete;
+
+    ~ConcurrentHashSet() {
+        free_retired(m_retired.load(std::memory_order_relaxed));
+        for (Table *t = m_current.load(std::memory_order_relaxed); t != nullptr;) {
+            Table *next = t->next.load(std::memory_order_relaxed);
+            delete t;
+            t = next;
+        }
+    }
+
+    // a snapshot which may be outdated by the time it is returned
+    size_type size() const {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Lock free. Calls f with the stored key if it is present and returns whether it is, the
+    // key may be erased concurrently but stays alive until f returns. f may modify the set,
+    // the tables it retires are then freed by a later write.
+    template<class F>
+    bool cvisit(const Key &key, F f) const {
+        const size_type hash = m_hash(key);
+        const ctrl_t tag = hash_tag(hash);
+        Guard guard(*this);
+        const Table *t = m_current.load(std::memory_order_acquire);
+        size_type pos = FibonacciReducer::index(hash, t->capacity);
+        // a migrated slot is read as what it was before, since the key it held may not have
+        // reached the new table yet
+        for (size_type step = 0; step < t->capacity; ++step) {
+            const Slot &slot = t->slots[pos];
+            const ctrl_word c = slot.ctrl.load(std::memory_order_acquire);
+            const State state = state_of(c);
+            if (state == EMPTY || state == FROZEN) {
+                return false;
+            }
+            if ((state == FULL || state == FROZEN_KEY || state == MIGRATING) && tag_of(c) == tag &&
+                m_equal(slot.key(), key)) {
+                f(slot.key());
+                return true;
+            }
+            pos = LinearProbing::next(pos, 0, t->capacity);
+        }
+        return false;
+    }
+
+    bool contains(const Key &key) const {
+        return cvisit(key, [](const Key &) {});
+    }
+
+    size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    bool insert(const Key &key) {
+        return emplace_impl(key);
+    }
+
+    bool insert(Key &&key) {
+        return emplace_impl(std::move(key));
+    }
+
+    size_type erase(const Key &key) {
+        size_type res;
+        {
+            Guard guard(*this);
+            res = erase_impl(key);
+        }
+        reclaim_retired();
+        return res;
+    }
+
+private:
+    static constexpr size_type migration_chunk = 256;
+
+    std::atomic<Table *> m_current{nullptr};
+    std::atomic<size_type> m_size{0};
+    hasher m_hash;
+    Equal m_equal;
+    std::atomic<size_type> m_epoch{0};
+    mutable OperationCount m_operations[2][operation_stripes];
+    // tables no longer current, linked through retired_next
+    std::atomic<Table *> m_retired{nullptr};
+    std::mutex m_reclaim_mutex;
+
+    std::atomic<size_type> &enter() const {
+        const size_type stripe = thread_stripe();
+        for (;;) {
+            const size_type epoch = m_epoch.load(std::memory_order_seq_cst);
+            std::atomic<size_type> &count = m_operations[epoch & 1][stripe].value;
+            count.fetch_add(1, std::memory_order_seq_cst);
+            // a reclaimer which advanced the epoch meanwhile may have missed the registration
+            if (m_epoch.load(std::memory_order_seq_cst) == epoch) {
+                return count;
+            }
+            count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Guards the calling thread holds on any set of this type. Reclaiming under one of them
+    // would wait for the thread itself.
+    static unsigned &guard_depth() {
+        thread_local unsigned depth = 0;
+        return depth;
+    }
+
+    static size_type thread_stripe() {
+        static std::atomic<size_type> next_stripe{0};
+        thread_local const size_type stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % operation_stripes;
+        return stripe;
+    }
+
+    // Frees the retired tables once the operations which may still walk them are over. Skipped
+    // when called under a Guard, from a write made by a cvisit callback.
+    void reclaim_retired() {
+        if (m_retired.load(std::memory_order_relaxed) == nullptr || guard_depth() != 0) {
+            return;
+        }
+        std::unique_lock lock(m_reclaim_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            // the tables retired meanwhile are left to the next write
+            return;
+        }
+        Table *retired = m_retired.exchange(nullptr, std::memory_order_acquire);
+        if (retired == nullptr) {
+            return;
+        }
+        // the operations started since see the current table, the others drain
+        const size_type epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        for (const OperationCount &count : m_operations[epoch & 1]) {
+            while (count.value.load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::yield();
+            }
+        }
+        free_retired(retired);
+    }
+
+    static void free_retired(Table *t) {
+        while (t != nullptr) {
+            Table *next = t->retired_next;
+            delete t;
+            t = next;
+        }
+    }
+
+    size_type erase_impl(const Key &key) {
+        const size_type hash = m_hash(key);
+        const ctrl_t tag = hash_tag(hash);
+        for (;;) {
+            Table *t = writable_table();
+            size_type pos = FibonacciReducer::index(hash, t->capacity);
+            bool frozen = false;
+            for (size_type step = 0; step < t->capacity && !frozen;) {
+                Slot &slot = t->slots[pos];
+                ctrl_word c = slot.ctrl.load(std::memory_order_acquire);
+                const State state = state_of(c);
+                if (state == EMPTY) {
+                    return 0;
+                }
+                if (is_frozen(state)) {
+                    frozen = true;
+                } else if (state == BUSY && tag_of(c) == tag) {
+                    std::this_thread::yield();
+                } else if (state == FULL && tag_of(c) == tag && m_equal(slot.key(), key)) {
+                    if (slot.ctrl.compare_exchange_strong(c, word(DELETED, tag), std::memory_order_acq_rel)) {
+                        m_size.fetch_sub(1, std::memory_order_relaxed);
+                        return 1;
+                    }
+                } else {
+                    ++step;
+                    pos = LinearProbing::next(pos, 0, t->capacity);
+                }
+            }
+            if (!frozen) {
+                return 0;
+            }
+        }
+    }
+
+    template<class K>
+    bool emplace_impl(K &&key) {
+        bool res;
+        {
+            Guard guard(*this);
+            res = insert_impl(std::forward<K>(key));
+        }
+        reclaim_retired();
+        return res;
+    }
+
+    template<class K>
+    bool insert_impl(K &&key) {
+        const size_type hash = m_hash(key);
+        for (;;) {
+            Table *t = writable_table();
+            if (static_cast<float>(t->used.load(std::memory_order_relaxed) + 1) >
+                max_load_factor * static_cast<float>(t->capacity)) {
+                start_migration(t);
+                continue;
+            }
+            switch (insert_into(t, hash, std::forward<K>(key), true)) {
+                case Result::INSERTED:
+                    m_size.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                case Result::PRESENT:
+                    return false;
+                case Result::FROZEN:
+                    break;
+            }
+        }
+    }
+
+    // the current table once no migration is in progress, helping to finish one if there is
+    Table *writable_table() {
+        for (;;) {
+            Table *t = m_current.load(std::memory_order_acquire);
+            if (t->next.load(std::memory_order_acquire) == nullptr) {
+                return t;
+            }
+            help_migrate(t);
+        }
+    }
+
+    // Claims the first empty slot on the probe sequence unless the key is found first (when
+    // check_present is set). The key is only consumed on INSERTED.
+    template<class K>
+    Result insert_into(Table *t, size_type hash, K &&key, bool check_present) {
+        const ctrl_t tag = hash_tag(hash);
+        size_type pos = FibonacciReducer::index(hash, t->capacity);
+        for (size_type step = 0; step < t->capacity;) {
+            Slot &slot = t->slots[pos];
+            ctrl_word c = slot.ctrl.load(std::memory_order_acquire);
+            const State state = state_of(c);
+            if (state == EMPTY) {
+                if (slot.ctrl.compare_exchange_strong(c, word(BUSY, tag), std::memory_order_acq_rel)) {
+                    try {
+                        new(slot.storage) Key(std::forward<K>(key));
+                    } catch (...) {
+                        // the slot was never visible as full
+                        slot.ctrl.store(word(ABANDONED, tag), std::memory_order_release);
+                        throw;
+                    }
+                    t->used.fetch_add(1, std::memory_order_relaxed);
+                    slot.ctrl.store(word(FULL, tag), std::memory_order_release);
+                    return Result::INSERTED;
+                }
+                continue;
+            }
+            if (is_frozen(state)) {
+                return Result::FROZEN;
+            }
+            if (check_present && tag_of(c) == tag) {
+                if (state == BUSY) {
+                    // the same key may be being inserted, wait until it is published
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (state == FULL && m_equal(slot.key(), key)) {
+                    return Result::PRESENT;
+                }
+            }
+            ++step;
+            pos = LinearProbing::next(pos, 0, t->capacity);
+        }
+        // overfilled by racing inserts
+        start_migration(t);
+        return Result::FROZEN;
+    }
+
+    void start_migration(Table *t) {
+        if (t->next.load(std::memory_order_acquire) != nullptr) {
+            return;
+        }
+        // live keys fill at most half the max load of the new table, tombstones are dropped
+        size_type capacity = t->capacity;
+        while (static_cast<float>(m_size.load(std::memory_order_relaxed) + 1) >
+               max_load_factor * 0.5f * static_cast<float>(capacity)) {
+            capacity <<= 1;
+        }
+        auto *next = new Table(capacity);
+        Table *expected = nullptr;
+        if (!t->next.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+            delete next;
+        }
+    }
+
+    static size_type chunk_count(size_type capacity) {
+        return (capacity + migration_chunk - 1) / migration_chunk;
+    }
+
+    // freezes the unclaimed chunks of t and copies their keys into t->next until every chunk
+    // is migrated, then makes the new table current
+    void help_migrate(Table *t) {
+        Table *next = t->next.load(std::memory_order_acquire);
+        const size_type chunks = chunk_count(t->capacity);
+        while (t->migrated.load(std::memory_order_acquire) < t->capacity) {
+            bool helped = false;
+            for (size_type c = 0; c < chunks; ++c) {
+                bool expected = false;
+                if (!t->claimed[c].load(std::memory_order_relaxed) &&
+                    t->claimed[c].compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    migrate_chunk(t, next, c);
+                    helped = true;
+                }
+            }
+            if (!helped) {
+                // the other helpers are copying the last chunks
+                std::this_thread::yield();
+            }
+        }
+        if (m_current.compare_exchange_strong(t, next, std::memory_order_acq_rel)) {
+            Table *head = m_retired.load(std::memory_order_relaxed);
+            do {
+                t->retired_next = head;
+            } while (!m_retired.compare_exchange_weak(head, t, std::memory_order_release, std::memory_order_relaxed));
+        }
+    }
+
+    // a chunk whose copy throws is unclaimed again, so that it is retried rather than waited for
+    void migrate_chunk(Table *t, Table *next, size_type c) {
+        const size_type begin = c * migration_chunk;
+        const size_type end = std::min(begin + migration_chunk, t->capacity);
+        try {
+            for (size_type i = begin; i < end; ++i) {
+                freeze(t->slots[i], next);
+            }
+        } catch (...) {
+            t->claimed[c].store(false, std::memory_order_release);
+            throw;
+        }
+        t->migrated.fetch_add(end - begin, std::memory_order_acq_rel);
+    }
+
+    // The slots already frozen by a failed attempt are left as they are. A key whose copy
+    // throws stays in the slot, which is full again.
+    void freeze(Slot &slot, Table *next) {
+        for (;;) {
+            ctrl_word c = slot.ctrl.load(std::memory_order_acquire);
+            const ctrl_t tag = tag_of(c);
+            switch (state_of(c)) {
+                case EMPTY:
+                    if (slot.ctrl.compare_exchange_strong(c, word(FROZEN, tag), std::memory_order_acq_rel)) {
+                        return;
+                    }
+                    break;
+                case BUSY:
+                    std::this_thread::yield();
+                    break;
+                case FULL:
+                    if (slot.ctrl.compare_exchange_strong(c, word(MIGRATING, tag), std::memory_order_acq_rel)) {
+                        // The key stays behind for readers of the old table. Until next becomes
+                        // current it only receives the keys of this table, which has no more
+                        // slots than next, so the copy finds an empty slot unless failed copies
+                        // abandoned too many of them.
+                        Result res;
+                        try {
+                            res = insert_into(next, m_hash(slot.key()), static_cast<const Key &>(slot.key()), false);
+                        } catch (...) {
+                            slot.ctrl.store(word(FULL, tag), std::memory_order_release);
+                            throw;
+                        }
+                        if (res != Result::INSERTED) {
+                            slot.ctrl.store(word(FULL, tag), std::memory_order_release);
+                            throw std::logic_error("ConcurrentHashSet: a migrated key did not fit the new table");
+                        }
+                        slot.ctrl.store(word(FROZEN_KEY, tag), std::memory_order_release);
+                        return;
+                    }
+                    break;
+                case DELETED:
+                    if (slot.ctrl.compare_exchange_strong(c, word(FROZEN_DELETED, tag), std::memory_order_acq_rel)) {
+                        return;
+                    }
+                    break;
+                case ABANDONED:
+                    if (slot.ctrl.compare_exchange_strong(c, word(FROZEN, tag), std::memory_order_acq_rel)) {
+                        return;
+                    }
+                    break;
+                default:
+                    return;
+            }
+        }
+    }
+};
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "hashers.h"
+#include "policy.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+// Integers and enums are hashed by IntegerHash, anything else as bytes by BytesHash: both are
+// constexpr, the standard hashes are not.
+template<class Key>
+using fixed_hash_t = std::conditional_t<std::is_integral_v<Key> || std::is_enum_v<Key>, IntegerHash, BytesHash>;
+
+namespace fixed {
+
+// Immutable table of N entries which can be built in a constexpr context. The home slot of a
+// hash is the top bits of its product with a multiplier, and the construction tries up to
+// max_multipliers of them: the first one sending every key to its own slot is kept, otherwise
+// the one giving the shortest probe sequences under CollisionPolicy. A lookup then probes at
+// most max_probe() slots, so a table with max_probe() == 1 finds any key with a hash, a
+// multiplication, a shift and one comparison. The slots which no key takes hold copies of
+// other entries: a key equal to such a copy is in the table with the same value, so the
+// lookups never check whether a slot is empty.
+template<class Key, class Entry, class KeyOf, std::size_t N, class CollisionPolicy, class Hash, class Equal>
+class FixedTable {
+    static_assert(CollisionPolicy::group_type::width == 1 && !is_robin_hood<CollisionPolicy>::value,
+                  "fixed tables are probed slot by slot");
+
+public:
+    using size_type = std::size_t;
+
+    // a power of two of at least twice the entries
+    static constexpr size_type capacity = [] {
+        size_type res = 2;
+        while (res < 2 * N) {
+            res <<= 1;
+        }
+        return res;
+    }();
+
+    static constexpr size_type max_multipliers = 256;
+
+    template<class Input, class Convert>
+    constexpr FixedTable(std::initializer_list<Input> init, Convert convert, const Hash &hash, const Equal &equal)
+            : m_hash(hash), m_equal(equal) {
+        if (init.size() != N) {
+            throw std::invalid_argument("FixedTable: the number of elements differs from N");
+        }
+        std::array<Entry, N> entries{};
+        std::array<size_type, N> hashes{};
+        size_type i = 0;
+        for (const Input &input : init) {
+            entries[i] = convert(input);
+            hashes[i] = m_hash(KeyOf::get(entries[i]));
+            ++i;
+        }
+        m_max_probe = N + 1;
+        for (size_type t = 0; t < max_multipliers && m_max_probe > 1; ++t) {
+            const std::uint64_t multiplier = hashing::mix64(t) | 1;
+            const size_type probe = max_probe_for(hashes, multiplier, m_max_probe);
+            if (probe < m_max_probe) {
+                m_max_probe = probe;
+                m_multiplier = multiplier;
+            }
+        }
+        place(entries, hashes);
+    }
+
+    constexpr size_type size() const {
+        return N;
+    }
+
+    // the longest probe sequence of a lookup, 1 when every key has its own slot
+    constexpr size_type max_probe() const {
+        return m_max_probe;
+    }
+
+    template<class K>
+    constexpr const Entry *find_entry(const K &key) const {
+        if constexpr (N == 0) {
+            return nullptr;
+        } else {
+            size_type pos = home(m_hash(key), m_multiplier);
+            for (size_type step_num = 1;; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+                if (m_equal(KeyOf::get(m_slots[pos]), key)) {
+                    return &m_slots[pos];
+                }
+                if (step_num == m_max_probe) {
+                    return nullptr;
+                }
+            }
+        }
+    }
+
+    // in the order of the initializer list
+    template<class F>
+    constexpr void for_each_entry(F f) const {
+        for (size_type i = 0; i < N; ++i) {
+            f(m_slots[m_order[i]]);
+        }
+    }
+
+private:
+    std::array<Entry, capacity> m_slots{};
+    // the slot of every entry, in their original order
+    std::array<size_type, N> m_order{};
+    std::uint64_t m_multiplier = 1;
+    size_type m_max_probe = 1;
+    Hash m_hash;
+    Equal m_equal;
+
+    static constexpr unsigned shift = [] {
+        unsigned res = 64;
+        for (size_type c = capacity; c > 1; c >>= 1) {
+            --res;
+        }
+        return res;
+    }();
+
+    static constexpr size_type home(size_type hash, std::uint64_t multiplier) {
+        return static_cast<size_type>((static_cast<std::uint64_t>(hash) * multiplier) >> shift);
+    }
+
+    // the longest probe sequence of the keys inserted in order, or limit once it is reached
+    static constexpr size_type max_probe_for(const std::array<size_type, N> &hashes, std::uint64_t multiplier,
+                                             size_type limit) {
+        std::array<bool, capacity> used{};
+        size_type res = 1;
+        for (size_type i = 0; i < N; ++i) {
+            size_type pos = home(hashes[i], multiplier);
+            size_type step_num = 1;
+            for (; used[pos]; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+            }
+            used[pos] = true;
+            if (step_num > res) {
+                res = step_num;
+                if (res >= limit) {
+                    return limit;
+                }
+            }
+        }
+        return res;
+    }
+
+    constexpr void place(const std::array<Entry, N> &entries, const std::array<size_type, N> &hashes) {
+        std::array<bool, capacity> used{};
+        for (size_type i = 0; i < N; ++i) {
+            size_type pos = home(hashes[i], m_multiplier);
+            for (size_type step_num = 1; used[pos]; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+                if (m_equal(KeyOf::get(m_slots[pos]), KeyOf::get(entries[i]))) {
+                    throw std::invalid_argument("FixedTable: duplicate key");
+                }
+            }
+            used[pos] = true;
+            m_slots[pos] = entries[i];
+            m_order[i] = pos;
+        }
+        for (size_type pos = 0; pos < capacity; ++pos) {
+            if (!used[pos] && N > 0) {
+                m_slots[pos] = entries[0];
+            }
+        }
+    }
+};
+
+} // namespace fixed
+
+// Immutable set of N keys, built at compile time when declared constexpr:
+//
+//     constexpr FixedHashSet<std::string_view, 3> keywords{"if", "else", "while"};
+//     static_assert(keywords.contains("else"));
+//
+// See fixed::FixedTable for the layout. Hash and Equal must be constexpr for that.
+template<
+        class Key,
+        std::size_t N,
+        class CollisionPolicy = LinearProbing,
+        class Hash = fixed_hash_t<Key>,
+        class Equal = std::equal_to<Key>
+>
+class FixedHashSet {
+    struct KeyOf {
+        static constexpr const Key &get(const Key &key) {
+            return key;
+        }
+    };
+
+    using Table = fixed::FixedTable<Key, Key, KeyOf, N, CollisionPolicy, guarded_hash_t<Hash>, Equal>;
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+
+    constexpr FixedHashSet(std::initializer_list<Key> keys, const hasher &hash = hasher(), const key_equal &equal = key_equal())
+            : m_table(keys, [](const Key &key) { return key; }, hash, equal) {}
+
+    constexpr size_type size() const {
+        return N;
+    }
+
+    constexpr bool empty() const {
+        return N == 0;
+    }
+
+    constexpr size_type capacity() const {
+        return Table::capacity;
+    }
+
+    constexpr size_type max_probe() const {
+        return m_table.max_probe();
+    }
+
+    constexpr const Key *find(const Key &key) const {
+        return m_table.find_entry(key);
+    }
+
+    constexpr bool contains(const Key &key) const {
+        return find(key) != nullptr;
+    }
+
+    constexpr size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    template<class F>
+    constexpr void for_each(F f) const {
+        m_table.for_each_entry(f);
+    }
+
+private:
+    Table m_table;
+};
+
+// Immutable map of N elements, built at compile time when declared constexpr:
+//
+//     constexpr FixedHashMap<std::string_view, int, 2> codes{{"ok", 200}, {"not found", 404}};
+//     static_assert(codes.at("ok") == 200);
+template<
+        class Key,
+        class T,
+        std::size_t N,
+        class CollisionPolicy = LinearProbing,
+        class Hash = fixed_hash_t<Key>,
+        class Equal = std::equal_to<Key>
+>
+class FixedHashMap {
+    // std::pair<const Key, T> is not assignable, the slots hold this instead
+    struct Entry {
+        Key key;
+        T value;
+    };
+
+    struct KeyOf {
+        static constexpr const Key &get(const Entry &entry) {
+            return entry.key;
+        }
+    };
+
+    using Table = fixed::FixedTable<Key, Entry, KeyOf, N, CollisionPolicy, guarded_hash_t<Hash>, Equal>;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+
+    constexpr FixedHashMap(std::initializer_list<value_type> values, const hasher &hash = hasher(), const key_equal &equal = key_equal())
+            : m_table(values, [](const value_type &value) { return Entry{value.first, value.second}; }, hash, equal) {}
+
+    constexpr size_type size() const {
+        return N;
+    }
+
+    constexpr bool empty() const {
+        return N == 0;
+    }
+
+    constexpr size_type capacity() const {
+        return Table::capacity;
+    }
+
+    constexpr size_type max_probe() const {
+        return m_table.max_probe();
+    }
+
+    constexpr const T *find(const Key &key) const {
+        const Entry *entry = m_table.find_entry(key);
+        return entry != nullptr ? &entry->value : nullptr;
+    }
+
+    constexpr bool contains(const Key &key) const {
+        return m_table.find_entry(key) != nullptr;
+    }
+
+    constexpr size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    constexpr const T &at(const Key &key) const {
+        const T *value = find(key);
+        if (value == nullptr) {
+            throw std::out_of_range("FixedHashMap::at");
+        }
+        return *value;
+    }
+
+    template<class F>
+    constexpr void for_each(F f) const {
+        m_table.for_each_entry([&f](const Entry &entry) {
+            f(entry.key, entry.value);
+        });
+    }
+
+private:
+    Table m_table;
+};
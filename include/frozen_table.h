@@ -0,0 +1,620 @@
+#pragma once
+
+#include "hash_map.h"
+#include "hash_set.h"
+#include "hash_table.h"
+#include "hashers.h"
+#include "policy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace frozen {
+
+// Immutable table over a minimal perfect hash, built the way PTHash does: the keys are spread
+// over buckets of bucket_load keys on average, and every bucket, largest first, gets the
+// smallest pilot sending all of its keys to slots nobody took yet. There are exactly as many
+// slots as keys of distinct hashes and a lookup reads the pilot of its bucket and compares the
+// key in the one slot they give, for a cost of four bytes per bucket. No pilot can separate
+// keys with the same full hash: the first of them gets the slot, the others are kept after the
+// slots, sorted by hash, and the lookups missing the slot search their hashes when there are
+// any. The order of the elements is the order of their slots, then of those hashes.
+template<class Key, class Value, class KeyOf, class Hash, class Equal, class Allocator>
+class FrozenTable {
+public:
+    using size_type = std::size_t;
+    using const_iterator = typename std::vector<Value, Allocator>::const_iterator;
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    static constexpr size_type bucket_load = 4;
+
+    FrozenTable(const Hash &hash, const Equal &equal, const Allocator &alloc)
+            : m_values(alloc), m_pilots(pilot_allocator(alloc)), m_extra_hashes(hash_allocator(alloc)),
+              m_hash(hash), m_equal(equal) {}
+
+    FrozenTable(const FrozenTable &other) = default;
+
+    FrozenTable(FrozenTable &&other) noexcept = default;
+
+    // the elements are never assigned, pairs with a const key are not assignable
+    FrozenTable &operator=(FrozenTable other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(FrozenTable &other) noexcept {
+        m_values.swap(other.m_values);
+        m_pilots.swap(other.m_pilots);
+        m_extra_hashes.swap(other.m_extra_hashes);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+    // Takes the elements of [first, last), which must have distinct keys, moving them when
+    // Move is set: the caller owns them then, even if the range only gives const access, as
+    // the iterators of a HashSet do.
+    template<bool Move, class ForwardIt>
+    void build(ForwardIt first, ForwardIt last) {
+        using element_pointer = std::conditional_t<Move, Value *, const Value *>;
+        std::vector<element_pointer> elements;
+        std::vector<size_type> hashes;
+        for (auto it = first; it != last; ++it) {
+            elements.push_back(const_cast<element_pointer>(&*it));
+            hashes.push_back(m_hash(KeyOf::get(*it)));
+        }
+        const size_type n = elements.size();
+        m_values.clear();
+        m_extra_hashes.clear();
+        m_pilots.assign((n + bucket_load - 1) / bucket_load, 0);
+        if (n == 0) {
+            return;
+        }
+        const size_type buckets = m_pilots.size();
+        // the keys sorted by bucket, then the buckets by decreasing size
+        std::vector<size_type> bucket_start(buckets + 1);
+        for (size_type i = 0; i < n; ++i) {
+            ++bucket_start[bucket_of(hashes[i]) + 1];
+        }
+        for (size_type b = 0; b < buckets; ++b) {
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        std::vector<size_type> keys(n);
+        {
+            std::vector<size_type> next(bucket_start.begin(), bucket_start.end() - 1);
+            for (size_type i = 0; i < n; ++i) {
+                keys[next[bucket_of(hashes[i])]++] = i;
+            }
+        }
+        // the first key of every hash stays in its bucket, the others become extras
+        const auto by_hash = [&](size_type l, size_type r) {
+            return hashes[l] < hashes[r];
+        };
+        std::vector<size_type> bucket_size(buckets), extras;
+        for (size_type b = 0; b < buckets; ++b) {
+            const size_type from = bucket_start[b], to = bucket_start[b + 1];
+            std::sort(keys.begin() + from, keys.begin() + to, by_hash);
+            size_type kept = from;
+            for (size_type k = from; k < to; ++k) {
+                if (k > from && hashes[keys[k]] == hashes[keys[kept - 1]]) {
+                    extras.push_back(keys[k]);
+                } else {
+                    keys[kept++] = keys[k];
+                }
+            }
+            bucket_size[b] = kept - from;
+        }
+        std::sort(extras.begin(), extras.end(), by_hash);
+        const size_type slots = n - extras.size();
+        std::vector<size_type> order(buckets);
+        for (size_type b = 0; b < buckets; ++b) {
+            order[b] = b;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_type l, size_type r) {
+            return bucket_size[l] > bucket_size[r];
+        });
+        std::vector<bool> taken(slots);
+        std::vector<size_type> slot_of(n), positions;
+        for (size_type b : order) {
+            const size_type from = bucket_start[b], to = from + bucket_size[b];
+            if (from == to) {
+                break;
+            }
+            for (std::uint64_t pilot = 0;; ++pilot) {
+                if (pilot > std::numeric_limits<std::uint32_t>::max()) {
+                    throw std::length_error("FrozenTable: no pilot found for a bucket");
+                }
+                if (try_pilot(static_cast<std::uint32_t>(pilot), hashes, keys, from, to, taken, positions)) {
+                    m_pilots[b] = static_cast<std::uint32_t>(pilot);
+                    for (size_type k = from; k < to; ++k) {
+                        slot_of[keys[k]] = positions[k - from];
+                    }
+                    break;
+                }
+            }
+        }
+        std::vector<size_type> element_at(slots);
+        for (size_type b = 0; b < buckets; ++b) {
+            for (size_type k = bucket_start[b]; k < bucket_start[b] + bucket_size[b]; ++k) {
+                element_at[slot_of[keys[k]]] = keys[k];
+            }
+        }
+        element_at.insert(element_at.end(), extras.begin(), extras.end());
+        m_values.reserve(n);
+        for (size_type i : element_at) {
+            if constexpr (Move) {
+                m_values.push_back(std::move(*elements[i]));
+            } else {
+                m_values.push_back(*elements[i]);
+            }
+        }
+        for (size_type i : extras) {
+            m_extra_hashes.push_back(hashes[i]);
+        }
+    }
+
+    size_type size() const {
+        return m_values.size();
+    }
+
+    const_iterator begin() const {
+        return m_values.begin();
+    }
+
+    const_iterator end() const {
+        return m_values.end();
+    }
+
+    const Value &value_at(size_type idx) const {
+        return m_values[idx];
+    }
+
+    template<class K>
+    size_type find_index(const K &key) const {
+        if (m_values.empty()) {
+            return npos;
+        }
+        const size_type hash = m_hash(key);
+        const size_type slots = m_values.size() - m_extra_hashes.size();
+        const size_type pos = position(hash, m_pilots[bucket_of(hash)], slots);
+        if (m_equal(KeyOf::get(m_values[pos]), key)) {
+            return pos;
+        }
+        return m_extra_hashes.empty() ? npos : find_extra(key, hash, slots);
+    }
+
+    const Hash &hash_function() const {
+        return m_hash;
+    }
+
+    const Equal &key_eq() const {
+        return m_equal;
+    }
+
+    Allocator get_allocator() const {
+        return m_values.get_allocator();
+    }
+
+private:
+    using pilot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint32_t>;
+    using hash_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<size_type>;
+
+    std::vector<Value, Allocator> m_values;
+    std::vector<std::uint32_t, pilot_allocator> m_pilots;
+    // hashes of the elements after the slots, which share them with the element of a slot
+    std::vector<size_type, hash_allocator> m_extra_hashes;
+    Hash m_hash;
+    Equal m_equal;
+
+    size_type bucket_of(size_type hash) const {
+        return FastRangeReducer::index(hash, m_pilots.size());
+    }
+
+    // the slot of a hash among n of them given the pilot of its bucket
+    static size_type position(size_type hash, std::uint32_t pilot, size_type n) {
+        return FastRangeReducer::index(static_cast<size_type>(hashing::mix64(hash ^ hashing::mix64(pilot))), n);
+    }
+
+    // positions receives the slots of the keys of the bucket, which are marked as taken on success
+    static bool try_pilot(std::uint32_t pilot, const std::vector<size_type> &hashes, const std::vector<size_type> &keys,
+                          size_type from, size_type to, std::vector<bool> &taken, std::vector<size_type> &positions) {
+        positions.clear();
+        for (size_type k = from; k < to; ++k) {
+            const size_type pos = position(hashes[keys[k]], pilot, taken.size());
+            if (taken[pos] || std::find(positions.begin(), positions.end(), pos) != positions.end()) {
+                return false;
+            }
+            positions.push_back(pos);
+        }
+        for (size_type pos : positions) {
+            taken[pos] = true;
+        }
+        return true;
+    }
+
+    template<class K>
+    size_type find_extra(const K &key, size_type hash, size_type slots) const {
+        auto it = std::lower_bound(m_extra_hashes.begin(), m_extra_hashes.end(), hash);
+        for (; it != m_extra_hashes.end() && *it == hash; ++it) {
+            const size_type idx = slots + static_cast<size_type>(it - m_extra_hashes.begin());
+            if (m_equal(KeyOf::get(m_values[idx]), key)) {
+                return idx;
+            }
+        }
+        return npos;
+    }
+};
+
+} // namespace frozen
+
+// Immutable map over a minimal perfect hash, see frozen::FrozenTable: a lookup hashes the key
+// and compares it to a single element, unless other keys share its full hash. Made by freeze()
+// from a HashMap, or from any range of pairs with distinct keys, which move iterators make it
+// take over.
+template<
+        class Key,
+        class T,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Allocator = std::allocator<std::pair<const Key, T>>
+>
+class FrozenHashMap {
+
+    struct KeyOf {
+        static const Key &get(const std::pair<const Key, T> &value) {
+            return value.first;
+        }
+    };
+
+    using Table = frozen::FrozenTable<Key, std::pair<const Key, T>, KeyOf, guarded_hash_t<Hash>, Equal, Allocator>;
+
+    static constexpr std::size_t npos = Table::npos;
+
+    template<class K>
+    using transparent_key = std::enable_if_t<is_transparent_lookup<Hash, Equal>::value, K>;
+
+public:
+    // types
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+    using reference = const value_type &;
+    using const_reference = const value_type &;
+
+    using iterator = typename Table::const_iterator;
+    using const_iterator = typename Table::const_iterator;
+
+    explicit FrozenHashMap(const hasher &hash = hasher(),
+                           const key_equal &equal = key_equal(),
+                           const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {}
+
+    template<class ForwardIt>
+    FrozenHashMap(ForwardIt first, ForwardIt last,
+                  const hasher &hash = hasher(),
+                  const key_equal &equal = key_equal(),
+                  const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {
+        m_table.template build<false>(first, last);
+    }
+
+    template<class ForwardIt>
+    FrozenHashMap(std::move_iterator<ForwardIt> first, std::move_iterator<ForwardIt> last,
+                  const hasher &hash = hasher(),
+                  const key_equal &equal = key_equal(),
+                  const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {
+        m_table.template build<true>(first.base(), last.base());
+    }
+
+    const_iterator begin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator cbegin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator end() const noexcept {
+        return m_table.end();
+    }
+
+    const_iterator cend() const noexcept {
+        return m_table.end();
+    }
+
+    bool empty() const {
+        return m_table.size() == 0;
+    }
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    hasher hash_function() const {
+        return m_table.hash_function();
+    }
+
+    key_equal key_eq() const {
+        return m_table.key_eq();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
+    }
+
+    void swap(FrozenHashMap &other) noexcept {
+        m_table.swap(other.m_table);
+    }
+
+    size_type count(const key_type &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type count(const K &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    const_iterator find(const key_type &key) const {
+        return iterator_at(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key) const {
+        return iterator_at(m_table.find_index(key));
+    }
+
+    bool contains(const key_type &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    const mapped_type &at(const key_type &key) const {
+        return m_table.value_at(existing_index(key)).second;
+    }
+
+    template<class K, class = transparent_key<K>>
+    const mapped_type &at(const K &key) const {
+        return m_table.value_at(existing_index(key)).second;
+    }
+
+    // compare two containers contents
+    friend bool operator==(const FrozenHashMap &lhs, const FrozenHashMap &rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (const auto &value : lhs) {
+            auto el = rhs.find(value.first);
+            if (el == rhs.end() || !(value.second == el->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const FrozenHashMap &lhs, const FrozenHashMap &rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    Table m_table;
+
+    const_iterator iterator_at(size_type idx) const {
+        return idx == npos ? end() : begin() + static_cast<difference_type>(idx);
+    }
+
+    template<class K>
+    size_type existing_index(const K &key) const {
+        size_type idx = m_table.find_index(key);
+        if (idx == npos) {
+            throw std::out_of_range("FrozenHashMap::at");
+        }
+        return idx;
+    }
+};
+
+// Immutable set over a minimal perfect hash, see FrozenHashMap.
+template<
+        class Key,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Allocator = std::allocator<Key>
+>
+class FrozenHashSet {
+
+    struct KeyOf {
+        static const Key &get(const Key &value) {
+            return value;
+        }
+    };
+
+    using Table = frozen::FrozenTable<Key, Key, KeyOf, guarded_hash_t<Hash>, Equal, Allocator>;
+
+    static constexpr std::size_t npos = Table::npos;
+
+    template<class K>
+    using transparent_key = std::enable_if_t<is_transparent_lookup<Hash, Equal>::value, K>;
+
+public:
+    // types
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+    using reference = const value_type &;
+    using const_reference = const value_type &;
+
+    using iterator = typename Table::const_iterator;
+    using const_iterator = typename Table::const_iterator;
+
+    explicit FrozenHashSet(const hasher &hash = hasher(),
+                           const key_equal &equal = key_equal(),
+                           const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {}
+
+    template<class ForwardIt>
+    FrozenHashSet(ForwardIt first, ForwardIt last,
+                  const hasher &hash = hasher(),
+                  const key_equal &equal = key_equal(),
+                  const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {
+        m_table.template build<false>(first, last);
+    }
+
+    template<class ForwardIt>
+    FrozenHashSet(std::move_iterator<ForwardIt> first, std::move_iterator<ForwardIt> last,
+                  const hasher &hash = hasher(),
+                  const key_equal &equal = key_equal(),
+                  const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {
+        m_table.template build<true>(first.base(), last.base());
+    }
+
+    const_iterator begin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator cbegin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator end() const noexcept {
+        return m_table.end();
+    }
+
+    const_iterator cend() const noexcept {
+        return m_table.end();
+    }
+
+    bool empty() const {
+        return m_table.size() == 0;
+    }
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    hasher hash_function() const {
+        return m_table.hash_function();
+    }
+
+    key_equal key_eq() const {
+        return m_table.key_eq();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
+    }
+
+    void swap(FrozenHashSet &other) noexcept {
+        m_table.swap(other.m_table);
+    }
+
+    size_type count(const key_type &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type count(const K &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    const_iterator find(const key_type &key) const {
+        return iterator_at(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key) const {
+        return iterator_at(m_table.find_index(key));
+    }
+
+    bool contains(const key_type &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    // compare two containers contents
+    friend bool operator==(const FrozenHashSet &lhs, const FrozenHashSet &rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (const auto &key : lhs) {
+            if (!rhs.contains(key)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const FrozenHashSet &lhs, const FrozenHashSet &rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    Table m_table;
+
+    const_iterator iterator_at(size_type idx) const {
+        return idx == npos ? end() : begin() + static_cast<difference_type>(idx);
+    }
+};
+
+// An immutable copy of map over a minimal perfect hash, with the same hasher and comparator.
+// Any map can be frozen, but the single probe per lookup needs the hasher to give distinct
+// keys distinct hashes: keys sharing a hash with another one are looked up with a binary
+// search over the hashes of such keys, after the probe. Throws std::length_error when no pilot
+// in 2^32 separates the hashes of a bucket, which takes distinct hashes colliding after the
+// finalizer for every pilot.
+template<class Key, class T, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy, class Allocator>
+FrozenHashMap<Key, T, Hash, Equal, Allocator>
+freeze(const HashMap<Key, T, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &map) {
+    return FrozenHashMap<Key, T, Hash, Equal, Allocator>(map.begin(), map.end(),
+                                                         map.hash_function(), map.key_eq(), map.get_allocator());
+}
+
+// the elements are moved out of map, which is left empty
+template<class Key, class T, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy, class Allocator>
+FrozenHashMap<Key, T, Hash, Equal, Allocator>
+freeze(HashMap<Key, T, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &&map) {
+    FrozenHashMap<Key, T, Hash, Equal, Allocator> res(std::make_move_iterator(map.begin()), std::make_move_iterator(map.end()),
+                                                      map.hash_function(), map.key_eq(), map.get_allocator());
+    map.clear();
+    return res;
+}
+
+// an immutable copy of set, as for a HashMap
+template<class Key, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy, class Allocator>
+FrozenHashSet<Key, Hash, Equal, Allocator>
+freeze(const HashSet<Key, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &set) {
+    return FrozenHashSet<Key, Hash, Equal, Allocator>(set.begin(), set.end(),
+                                                      set.hash_function(), set.key_eq(), set.get_allocator());
+}
+
+template<class Key, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy, class Allocator>
+FrozenHashSet<Key, Hash, Equal, Allocator>
+freeze(HashSet<Key, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &&set) {
+    FrozenHashSet<Key, Hash, Equal, Allocator> res(std::make_move_iterator(set.begin()), std::make_move_iterator(set.end()),
+                                                   set.hash_function(), set.key_eq(), set.get_allocator());
+    set.clear();
+    return res;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Control bytes: a full slot stores the 7-bit tag of its hash, free slots have the sign bit set.
+using ctrl_t = signed char;
+
+constexpr ctrl_t CTRL_EMPTY = -128;
+constexpr ctrl_t CTRL_DELETED = -2;
+
+inline bool is_full(ctrl_t c) {
+    return c >= 0;
+}
+
+inline ctrl_t hash_tag(std::size_t hash) {
+    return static_cast<ctrl_t>(hash >> (sizeof(std::size_t) * 8 - 7));
+}
+
+inline unsigned count_trailing_zeros(std::uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+    unsigned n = 0;
+    for (; (x & 1) == 0; x >>= 1, ++n);
+    return n;
+#endif
+}
+
+// hints the cache about an upcoming read, a no-op where the compiler has no builtin for it
+inline void prefetch(const void *addr) {
+#if defined(__GNUC__)
+    __builtin_prefetch(addr);
+#elif defined(_M_X64)
+    _mm_prefetch(static_cast<const char *>(addr), _MM_HINT_T0);
+#else
+    (void) addr;
+#endif
+}
+
+// Set of slot offsets inside a group; every offset takes 2^Shift bits of the mask.
+template<class T, unsigned Shift>
+class BitMask {
+    T m_mask;
+
+public:
+    explicit BitMask(T mask) : m_mask(mask) {}
+
+    explicit operator bool() const {
+        return m_mask != 0;
+    }
+
+    unsigned lowest() const {
+        return count_trailing_zeros(m_mask) >> Shift;
+    }
+
+    BitMask begin() const {
+        return *this;
+    }
+
+    BitMask end() const {
+        return BitMask(0);
+    }
+
+    unsigned operator*() const {
+        return lowest();
+    }
+
+    BitMask &operator++() {
+        m_mask &= m_mask - 1;
+        return *this;
+    }
+
+    friend bool operator!=(const BitMask &l, const BitMask &r) {
+        return l.m_mask != r.m_mask;
+    }
+};
+
+// One control byte at a time, used by the classic probing policies.
+struct ScalarGroup {
+    static constexpr std::size_t width = 1;
+
+    using mask_type = BitMask<std::uint32_t, 0>;
+
+    ctrl_t ctrl;
+
+    explicit ScalarGroup(const ctrl_t *pos) : ctrl(*pos) {}
+
+    mask_type match(ctrl_t tag) const {
+        return mask_type(ctrl == tag);
+    }
+
+    mask_type match_empty() const {
+        return mask_type(ctrl == CTRL_EMPTY);
+    }
+
+    mask_type match_free() const {
+        return mask_type(ctrl < 0);
+    }
+
+    mask_type match_full() const {
+        return mask_type(ctrl >= 0);
+    }
+};
+
+// Eight control bytes compared with plain 64-bit arithmetic where no SIMD is available.
+// match() may report a false positive next to a real one, which only costs an extra Equal call.
+struct PortableGroup {
+    static constexpr std::size_t width = 8;
+
+    using mask_type = BitMask<std::uint64_t, 3>;
+
+    static constexpr std::uint64_t lsbs = 0x0101010101010101ULL;
+    static constexpr std::uint64_t msbs = 0x8080808080808080ULL;
+
+    std::uint64_t ctrl;
+
+    explicit PortableGroup(const ctrl_t *pos) {
+        std::memcpy(&ctrl, pos, sizeof(ctrl));
+    }
+
+    mask_type match(ctrl_t tag) const {
+        std::uint64_t x = ctrl ^ (lsbs * static_cast<unsigned char>(tag));
+        return mask_type((x - lsbs) & ~x & msbs);
+    }
+
+    mask_type match_empty() const {
+        return mask_type(ctrl & ~(ctrl << 6) & msbs);
+    }
+
+    mask_type match_free() const {
+        return mask_type(ctrl & msbs);
+    }
+
+    mask_type match_full() const {
+        return mask_type(~ctrl & msbs);
+    }
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+struct SseGroup {
+    static constexpr std::size_t width = 16;
+
+    using mask_type = BitMask<std::uint32_t, 0>;
+
+    __m128i ctrl;
+
+    explicit SseGroup(const ctrl_t *pos) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+    mask_type match(ctrl_t tag) const {
+        return mask_type(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl))));
+    }
+
+    mask_type match_empty() const {
+        return match(CTRL_EMPTY);
+    }
+
+    mask_type match_free() const {
+        return mask_type(static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl)));
+    }
+
+    mask_type match_full() const {
+        return mask_type(static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl)) ^ 0xFFFFu);
+    }
+};
+
+#endif
+
+#if defined(__AVX2__)
+
+struct AvxGroup {
+    static constexpr std::size_t width = 32;
+
+    using mask_type = BitMask<std::uint32_t, 0>;
+
+    __m256i ctrl;
+
+    explicit AvxGroup(const ctrl_t *pos) : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos))) {}
+
+    mask_type match(ctrl_t tag) const {
+        return mask_type(static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(tag), ctrl))));
+    }
+
+    mask_type match_empty() const {
+        return match(CTRL_EMPTY);
+    }
+
+    mask_type match_free() const {
+        return mask_type(static_cast<std::uint32_t>(_mm256_movemask_epi8(ctrl)));
+    }
+
+    mask_type match_full() const {
+        return mask_type(~static_cast<std::uint32_t>(_mm256_movemask_epi8(ctrl)));
+    }
+};
+
+using SimdGroup = AvxGroup;
+#elif defined(__SSE2__) || defined(_M_X64)
+using SimdGroup = SseGroup;
+#else
+using SimdGroup = PortableGroup;
+#endif
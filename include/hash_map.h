@@ -1,24 +1,43 @@
 #pragma once
 
+#include "hash_table.h"
 #include "policy.h"
+#include "thread_executor.h"
 #include <functional>
-#include <iostream>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 
 template<
         class Key,
         class T,
         class CollisionPolicy = LinearProbing,
         class Hash = std::hash<Key>,
-        class Equal = std::equal_to<Key>
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<std::pair<const Key, T>>
 >
 class HashMap {
 
-    class Iterator;
+    struct KeyOf {
+        static const Key &get(const std::pair<const Key, T> &value) {
+            return value.first;
+        }
+    };
 
-    class ConstIterator;
+    using Table = HashTable<Key, std::pair<const Key, T>, KeyOf, CollisionPolicy, guarded_hash_t<Hash>, Equal, Reducer, GrowthPolicy, Allocator>;
 
-    struct Node;
+    static constexpr std::size_t npos = Table::npos;
+
+    // overloads taking other key types are enabled only for transparent Hash and Equal;
+    // iterators are excluded so that erase(iterator) is not taken for a key
+    template<class K>
+    using transparent_key = std::enable_if_t<is_transparent_lookup<Hash, Equal>::value &&
+                                             !std::is_convertible_v<const K &, typename Table::const_iterator> &&
+                                             !std::is_convertible_v<const K &, typename Table::iterator>, K>;
 
 public:
     // types
@@ -27,137 +46,128 @@ public:
     using value_type = std::pair<const Key, T>;
     using size_type = std::size_t;
     using difference_type = std::ptrdiff_t;
-    using hasher = Hash;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
     using key_equal = Equal;
+    using allocator_type = Allocator;
     using reference = value_type &;
     using const_reference = const value_type &;
     using pointer = value_type *;
     using const_pointer = const value_type *;
 
-    using iterator = Iterator;
-    using const_iterator = ConstIterator;
+    using iterator = typename Table::iterator;
+    using const_iterator = typename Table::const_iterator;
 
     explicit HashMap(size_type expected_max_size = 1,
                      const hasher &hash = hasher(),
-                     const key_equal &equal = key_equal()) : m_hash(hash), m_equal(equal) {
-        m_elements = std::vector<std::shared_ptr<Node>>(expected_max_size * 2, nullptr);
-        m_states = std::vector<State>(expected_max_size * 2, UNDEFINED);
-        m_end = nullptr;
-        m_begin = nullptr;
-        m_last = nullptr;
-        m_size = 0;
-    }
+                     const key_equal &equal = key_equal(),
+                     const allocator_type &alloc = allocator_type()) : m_table(expected_max_size, hash, equal, alloc) {}
+
+    explicit HashMap(const allocator_type &alloc) : HashMap(1, hasher(), key_equal(), alloc) {}
 
     template<class InputIt>
     HashMap(InputIt first, InputIt last,
             size_type expected_max_size = 1,
             const hasher &hash = hasher(),
-            const key_equal &equal = key_equal()) : HashMap(expected_max_size, hash, equal) {
-        for (auto it = first; it != last; ++it) {
-            insert(*it);
-        }
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type()) : HashMap(expected_max_size, hash, equal, alloc) {
+        insert(first, last);
     }
 
-    HashMap(const HashMap &hm) : HashMap(hm.m_elements.size() / 2, hm.m_hash, hm.m_equal) {
-        for (size_type i = 0; i < m_elements.size(); ++i) {
-            m_states[i] = hm.m_states[i];
-            if (hm.m_elements[i] == nullptr) {
-                continue;
-            }
-            m_elements[i] = std::make_shared<Node>(hm.m_elements[i]->paired_value);
-            m_elements[i]->idx = i;
-            if (hm.m_begin == hm.m_elements[i]) {
-                m_begin = m_elements[i];
-            }
-            if (hm.m_last == hm.m_elements[i]) {
-                m_last = m_elements[i];
-            }
-        }
-        auto prev = m_begin;
-        for (auto it = ++hm.begin(); it != hm.end(); ++it) {
-            size_type idx = it.data->idx;
-            m_elements[idx]->prev = prev;
-            prev->next = m_elements[idx];
-        }
-        m_size = hm.m_size;
+    // builds the container in parallel, see insert(first, last, executor)
+    template<class InputIt, class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    HashMap(InputIt first, InputIt last, Executor &&executor,
+            size_type expected_max_size = 1,
+            const hasher &hash = hasher(),
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type()) : HashMap(expected_max_size, hash, equal, alloc) {
+        insert(first, last, executor);
     }
 
-    HashMap(HashMap &&hm) noexcept : HashMap(hm.m_elements.size() / 2, hm.m_hash, hm.m_equal) {
-        m_elements = std::move(hm.m_elements);
-        m_states = std::move(hm.m_states);
-        m_size = std::move(hm.m_size);
-        m_begin = hm.m_begin;
-        m_last = hm.m_last;
-        hm.m_begin = hm.m_last = nullptr;
-    };
+    HashMap(const HashMap &hm) = default;
+
+    HashMap(const HashMap &hm, const allocator_type &alloc) : m_table(hm.m_table, alloc) {}
+
+    HashMap(HashMap &&hm) noexcept = default;
 
     HashMap(std::initializer_list<value_type> init,
             size_type expected_max_size = 0,
             const hasher &hash = hasher(),
-            const key_equal &equal = key_equal()) : HashMap(init.begin(), init.end(), expected_max_size, hash, equal) {}
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type())
+            : HashMap(init.begin(), init.end(), expected_max_size, hash, equal, alloc) {}
 
     HashMap &operator=(const HashMap &hm) = default;
 
     HashMap &operator=(HashMap &&hm) noexcept = default;
 
     HashMap &operator=(std::initializer_list<value_type> init) {
-        this(init, init.size());
+        clear();
+        reserve(init.size());
+        insert(init);
         return *this;
     }
 
-    ~HashMap() {
-        erase(begin(), end());
-    }
-
     iterator begin() noexcept {
-        return Iterator(m_begin);
+        return m_table.begin();
     }
 
     const_iterator begin() const noexcept {
-        return ConstIterator(m_begin);
+        return m_table.begin();
     }
 
     const_iterator cbegin() const noexcept {
-        return ConstIterator(m_begin);
+        return m_table.begin();
     }
 
     iterator end() noexcept {
-        return Iterator(m_end);
+        return m_table.end();
     }
 
     const_iterator end() const noexcept {
-        return ConstIterator(m_end);
+        return m_table.end();
     }
 
     const_iterator cend() const noexcept {
-        return ConstIterator(m_end);
+        return m_table.end();
     }
 
     bool empty() const {
-        return m_size == 0;
+        return m_table.size() == 0;
     }
 
     size_type size() const {
-        return m_size;
+        return m_table.size();
+    }
+
+    // the hasher giving the hashes the precomputed-hash overloads take, which is not Hash
+    // itself when Hash is weak
+    hasher hash_function() const {
+        return m_table.hash_function();
+    }
+
+    key_equal key_eq() const {
+        return m_table.key_eq();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
     }
 
     size_type max_size() const {
-        return m_elements.size();
+        return m_table.capacity();
     }
 
     void clear() {
-        erase(begin(), end());
-        m_elements.clear();
-        m_states.clear();
-        m_size = 0;
+        m_table.clear();
     }
 
     std::pair<iterator, bool> insert(const value_type &value) {
-        return insert_by_hint(m_end, std::make_shared<Node>(value));
+        return wrap(m_table.insert_by_hint(npos, value));
     }
 
     std::pair<iterator, bool> insert(value_type &&value) {
-        return insert_by_hint(m_end, std::make_shared<Node>(std::move(value)));
+        return wrap(m_table.insert_by_hint(npos, std::move(value)));
     }
 
     template<class P>
@@ -166,11 +176,11 @@ public:
     }
 
     iterator insert(const_iterator hint, const value_type &value) {
-        return insert_by_hint(hint.data, std::make_shared<Node>(value)).first;
+        return wrap(m_table.insert_by_hint(hint.index(), value)).first;
     }
 
     iterator insert(const_iterator hint, value_type &&value) {
-        return insert_by_hint(hint.data, std::make_shared<Node>(std::move(value))).first;
+        return wrap(m_table.insert_by_hint(hint.index(), std::move(value))).first;
     }
 
     template<class P>
@@ -185,51 +195,48 @@ public:
         }
     }
 
+    // The same result with the tasks of executor (ThreadExecutor or any callable satisfying
+    // is_executor) when the range is random access and its elements are pairs holding key_type keys.
+    template<class InputIt, class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    void insert(InputIt first, InputIt last, Executor &&executor) {
+        if constexpr (parallel_range<InputIt>(0)) {
+            m_table.insert_parallel(first, last, [](const auto &value) -> const key_type & { return value.first; }, executor);
+        } else {
+            insert(first, last);
+        }
+    }
+
     void insert(std::initializer_list<value_type> init) {
         insert(init.begin(), init.end());
     }
 
+    // hash must be hash_function()(key) for the key of value, not the raw output of Hash
+    std::pair<iterator, bool> insert_with_hash(const value_type &value, size_type hash) {
+        return wrap(m_table.emplace_with_hash(npos, value.first, hash, value));
+    }
+
+    std::pair<iterator, bool> insert_with_hash(value_type &&value, size_type hash) {
+        return wrap(m_table.emplace_with_hash(npos, value.first, hash, std::move(value)));
+    }
+
     template<class M>
     std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&value) {
-        auto found = find(key);
-        if (found.data != m_end) {
-            found.data->paired_value.second = std::move(value);
-            return std::make_pair(found, false);
-        } else {
-            return emplace(key, std::forward<M>(value));
-        }
+        return wrap(assign_impl(npos, key, std::forward<M>(value)));
     }
 
     template<class M>
     std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&value) {
-        auto found = find(std::forward<const key_type>(key));
-        if (found.data != m_end) {
-            found.data->paired_value.second = std::move(value);
-            return std::make_pair(found, false);
-        } else {
-            return insert_by_hint(m_end, std::make_shared<Node>(std::move(key), std::forward<M>(value)));
-        }
+        return wrap(assign_impl(npos, std::move(key), std::forward<M>(value)));
     }
 
     template<class M>
     iterator insert_or_assign(const_iterator hint, const key_type &key, M &&value) {
-        auto found = find(key);
-        if (found.data == m_end) {
-            return insert(hint, value_type(key, std::forward<M>(value)));
-        } else {
-            return found;
-        }
+        return wrap(assign_impl(hint.index(), key, std::forward<M>(value))).first;
     }
 
     template<class M>
     iterator insert_or_assign(const_iterator hint, key_type &&key, M &&value) {
-        auto found = find(key);
-        if (found.data == m_end) {
-            return insert_by_hint(hint.data,
-                                  std::make_shared<Node>(std::move(key), std::forward<M>(value))).first;
-        } else {
-            return found;
-        }
+        return wrap(assign_impl(hint.index(), std::move(key), std::forward<M>(value))).first;
     }
 
     // construct element in-place, no copy or move operations are performed;
@@ -237,186 +244,202 @@ public:
     // (using `std::forward<Args>(args)...`)
     template<class... Args>
     std::pair<iterator, bool> emplace(Args &&... args) {
-        auto to_emplace = std::make_shared<Node>(std::forward<Args>(args)...);
-        return insert_by_hint(m_end, to_emplace);
+        return wrap(emplace_impl(npos, std::forward<Args>(args)...));
     }
 
     template<class... Args>
     iterator emplace_hint(const_iterator hint, Args &&... args) {
-        return insert_by_hint(hint.data, std::make_shared<Node>(std::forward<Args>(args)...)).first;
+        return wrap(emplace_impl(hint.index(), std::forward<Args>(args)...)).first;
     }
 
     template<class... Args>
     std::pair<iterator, bool> try_emplace(const key_type &key, Args &&... args) {
-        iterator same = find(key);
-        if (same.data != m_end) {
-            return std::make_pair(same, false);
-        } else {
-            return insert_by_hint(m_end, std::make_shared<Node>(
-                    std::piecewise_construct,
-                    std::forward_as_tuple(std::forward<const Key>(key)),
-                    std::forward_as_tuple(std::forward<Args>(args)...)));
-        }
+        return wrap(try_emplace_impl(npos, key, std::forward<Args>(args)...));
     }
 
     template<class... Args>
     std::pair<iterator, bool> try_emplace(key_type &&key, Args &&... args) {
-        iterator same = find(key);
-        if (same.data != m_end) {
-            return std::make_pair(same, false);
-        } else {
-            return insert_by_hint(m_end,
-                                  std::make_shared<Node>(
-                                          std::piecewise_construct, std::forward_as_tuple(std::move(key)),
-                                          std::forward_as_tuple(std::forward<Args>(args)...)));
-        }
+        return wrap(try_emplace_impl(npos, std::move(key), std::forward<Args>(args)...));
     }
 
     template<class... Args>
     iterator try_emplace(const_iterator hint, const key_type &key, Args &&... args) {
-        iterator same = find(key);
-        if (same.data != m_end) {
-            return same;
-        } else {
-            return insert_by_hint(hint.data,
-                                  std::make_shared<Node>(std::piecewise_construct,
-                                                         std::forward_as_tuple(key),
-                                                         std::forward_as_tuple(std::forward<Args>(args)...))).first;
-        }
+        return wrap(try_emplace_impl(hint.index(), key, std::forward<Args>(args)...)).first;
     }
 
     template<class... Args>
     iterator try_emplace(const_iterator hint, key_type &&key, Args &&... args) {
-        iterator same = find(key);
-        if (same.data != m_end) {
-            return same;
-        } else {
-            return insert_by_hint(hint.data,
-                                  std::make_shared<Node>(std::piecewise_construct,
-                                                         std::forward_as_tuple(std::move(key)),
-                                                         std::forward_as_tuple(std::forward<Args>(args)...))).first;
-        }
+        return wrap(try_emplace_impl(hint.index(), std::move(key), std::forward<Args>(args)...)).first;
     }
 
     iterator erase(const_iterator pos) {
-        return pos.data == m_end ? end() : erase_by_idx(pos.data->idx);
+        return pos == end() ? end() : m_table.make_iterator(m_table.erase_by_idx(pos.index()));
     }
 
     iterator erase(const_iterator first, const_iterator last) {
-        std::vector<size_type> to_erase;
-        for (auto it = first; it != last; ++it) {
-            to_erase.push_back(it.data->idx);
-        }
-        iterator last_erased = Iterator(m_end);
-        for (auto idx : to_erase) {
-            last_erased = erase_by_idx(idx);
+        // erasing may move the elements after first, so last cannot be compared against
+        for (auto n = std::distance(first, last); n > 0; --n) {
+            first = erase(first);
         }
-        to_erase.clear();
-
-        return last_erased;
+        return m_table.make_iterator(first.index());
     }
 
     size_type erase(const key_type &key) {
-        size_type to_erase_idx = m_hash(key) % m_elements.size();
-        if (m_states[to_erase_idx] == DEFINED) {
-            erase_by_idx(to_erase_idx);
-            return 1;
-        }
-        return 0;
+        return erase_key(key);
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type erase(const K &key) {
+        return erase_key(key);
     }
 
     // exchanges the contents of the container with those of other;
     // does not invoke any move, copy, or swap operations on individual elements
     void swap(HashMap &&other) noexcept {
-        std::swap(m_elements, other.m_elements);
-        std::swap(m_states, other.m_states);
-        std::swap(m_size, other.m_size);
-        std::swap(m_begin, other.m_begin);
-        std::swap(m_last, other.m_last);
-        std::swap(m_end, other.m_end);
+        m_table.swap(other.m_table);
+    }
+
+    void swap(HashMap &other) noexcept {
+        m_table.swap(other.m_table);
     }
 
     size_type count(const key_type &key) const {
-        return find(key).data == m_end ? 0 : 1;
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type count(const K &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
     }
 
     iterator find(const key_type &key) {
-        size_type start_idx = m_hash(key) % m_elements.size();
-        if (m_states[start_idx] == DEFINED && m_equal(key, m_elements[start_idx]->paired_value.first)) {
-            return iterator(m_elements[start_idx]);
-        }
-        for (size_type step_num = 1, idx = CollisionPolicy::next(start_idx, step_num++, m_elements.size());
-             m_states[idx] != UNDEFINED;
-             idx = CollisionPolicy::next(idx, step_num++, m_elements.size())) {
-            if (m_states[idx] == DEFINED && m_equal(m_elements[idx]->paired_value.first, key)) {
-                return iterator(m_elements[idx]);
-            }
-        }
-        return iterator(m_end);
+        return m_table.make_iterator(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    iterator find(const K &key) {
+        return m_table.make_iterator(m_table.find_index(key));
     }
 
     const_iterator find(const key_type &key) const {
-        size_type start_idx = m_hash(key) % m_elements.size();
-        if (m_states[start_idx] == DEFINED && m_equal(key, m_elements[start_idx]->paired_value.first)) {
-            return const_iterator(m_elements[start_idx]);
-        }
-        for (size_type step_num = 1, idx = CollisionPolicy::next(start_idx, step_num++, m_elements.size());
-             m_states[idx] != UNDEFINED;
-             idx = CollisionPolicy::next(idx, step_num++, m_elements.size())) {
-            if (m_states[idx] == DEFINED && m_equal(m_elements[idx]->paired_value.first, key)) {
-                return const_iterator(m_elements[idx]);
-            }
-        }
-        return const_iterator(m_end);
+        return m_table.make_iterator(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key) const {
+        return m_table.make_iterator(m_table.find_index(key));
     }
 
     bool contains(const key_type &key) const {
-        return find(key).data != m_end;
+        return m_table.find_index(key) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    // batched lookups writing an iterator (or a flag) per key of [first, last) to out;
+    // memory accesses of up to 16 keys are overlapped
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = m_table.make_iterator(idx);
+        });
+        return out;
+    }
+
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = m_table.make_iterator(idx);
+        });
+        return out;
+    }
+
+    template<class ForwardIt, class OutputIt>
+    OutputIt contains_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = idx != npos;
+        });
+        return out;
+    }
+
+    // lookups by a precomputed hash, which must be hash_function()(key): Hash is wrapped in a
+    // finalizer when it is weak (see guarded_hash_t), so hashing with Hash{} misses the keys
+    iterator find(const key_type &key, size_type hash) {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    const_iterator find(const key_type &key, size_type hash) const {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    template<class K, class = transparent_key<K>>
+    iterator find(const K &key, size_type hash) {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key, size_type hash) const {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    bool contains(const key_type &key, size_type hash) const {
+        return m_table.find_index(key, hash) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key, size_type hash) const {
+        return m_table.find_index(key, hash) != npos;
     }
 
     std::pair<iterator, iterator> equal_range(const key_type &key) {
         iterator found = find(key);
-        return (found.data == m_end ? std::make_pair(Iterator(m_end), Iterator(m_end)) : std::make_pair(found, Iterator(
-                found.data->next)));
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
+    }
+
+    template<class K, class = transparent_key<K>>
+    std::pair<iterator, iterator> equal_range(const K &key) {
+        iterator found = find(key);
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
     }
 
     std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const {
         const_iterator found = find(key);
-        return (found.data == m_end ? std::make_pair(ConstIterator(m_end), ConstIterator(m_end))
-                                    : std::make_pair(found, ConstIterator(found.data->next)));
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
+    }
+
+    template<class K, class = transparent_key<K>>
+    std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+        const_iterator found = find(key);
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
     }
 
     mapped_type &at(const key_type &key) {
-        auto found = find(key);
-        if (found.data != m_end) {
-            return found.data->paired_value.second;
-        }
-        throw std::out_of_range("HashMap::at");
+        return m_table.value_at(existing_index(key)).second;
+    }
+
+    template<class K, class = transparent_key<K>>
+    mapped_type &at(const K &key) {
+        return m_table.value_at(existing_index(key)).second;
     }
 
     const mapped_type &at(const key_type &key) const {
-        return at(key);
+        return m_table.value_at(existing_index(key)).second;
+    }
+
+    template<class K, class = transparent_key<K>>
+    const mapped_type &at(const K &key) const {
+        return m_table.value_at(existing_index(key)).second;
     }
 
     mapped_type &operator[](const key_type &key) {
-        iterator found = find(key);
-        if (found == end()) {
-            return insert(
-                    value_type(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>())).first->second;
-        } else {
-            return found->second;
-        }
+        return try_emplace(key).first->second;
     }
 
     mapped_type &operator[](key_type &&key) {
-        iterator found = find(key);
-        if (found == end()) {
-            return insert_by_hint(m_end, std::make_shared<Node>(
-                    std::piecewise_construct, std::forward_as_tuple(std::move(key)),
-                    std::tuple<>())).first->second;
-        } else {
-            return found->second;
-        }
+        return try_emplace(std::move(key)).first->second;
     }
 
     size_type bucket_count() const {
@@ -424,60 +447,54 @@ public:
     }
 
     size_type max_bucket_count() const {
-        return m_elements.size();
+        return m_table.capacity();
     }
 
     size_type bucket_size(const size_type idx) const {
-        return m_elements[idx] == nullptr ? 0 : 1;
+        return m_table.is_defined(idx) ? 1 : 0;
     }
 
     size_type bucket(const key_type &key) const {
-        auto found = find(key);
-        return found.data == m_end ? 0 : found.data->idx;
+        size_type idx = m_table.find_index(key);
+        return idx == npos ? 0 : idx;
     }
 
     float load_factor() const {
-        return static_cast<float>(m_size) / static_cast<float>(bucket_count());
+        return bucket_count() == 0 ? 0.0f : static_cast<float>(size()) / static_cast<float>(bucket_count());
     }
 
     float max_load_factor() const {
-        return m_size > 0 ? 1.0f : 0.0f;
+        return m_table.max_load_factor();
+    }
+
+    void max_load_factor(float ml) {
+        m_table.max_load_factor(ml);
     }
 
     void rehash(const size_type count) {
-        if (count > m_elements.size() / 2) {
-            std::vector<std::shared_ptr<Node>> tmp(std::move(m_elements));
-            m_elements.clear();
-            m_states.clear();
-            m_elements.resize(count * 2, nullptr);
-            m_states.resize(count * 2, UNDEFINED);
-            m_end = nullptr;
-            m_begin = m_last = m_end;
-            m_size = 0;
-            for (auto it:tmp) {
-                if (it != nullptr) {
-                    insert_by_hint(m_end, it);
-                }
-            }
-        }
+        m_table.rehash(count);
+    }
+
+    // moves the elements with the tasks of executor
+    template<class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    void rehash(const size_type count, Executor &&executor) {
+        m_table.rehash(count, executor);
     }
 
     void reserve(size_type count) {
-        if (count > m_elements.size() / 2) {
-            rehash(count);
-        }
+        m_table.rehash(count);
     }
 
     // compare two containers contents
     friend bool operator==(const HashMap &lhs, const HashMap &rhs) {
-        if (lhs.m_size != rhs.m_size) {
+        if (lhs.size() != rhs.size()) {
             return false;
         }
         for (auto it = lhs.begin(); it != lhs.end(); ++it) {
             auto el = rhs.find(it->first);
             if (el == rhs.end()) { //doesn't contain key
                 return false;
-            } else if (!(it->second == el->second)){    //let's believe that mapped_value has operator==
+            } else if (!(it->second == el->second)) {    //let's believe that mapped_value has operator==
                 return false;                           //we don't always have operator!=(((
             }
         }
@@ -488,249 +505,123 @@ public:
         return !(lhs == rhs);
     }
 
-private:
-    enum State {
-        UNDEFINED, DEFINED, DELETED
-    };
-
-    std::pair<iterator, bool>
-    insert_by_hint(const std::shared_ptr<Node> &hint, const std::shared_ptr<Node> &to_insert) {
-        if (m_elements.size() < 2) {
-            reserve(1);
-        }
-        size_type start_idx = m_hash(to_insert->paired_value.first) % m_elements.size();
-        size_type free_idx;
-        if (m_states[start_idx] == DELETED || m_states[start_idx] == UNDEFINED) {
-            free_idx = start_idx;
-        } else {
-            if (m_equal(m_elements[start_idx]->paired_value.first, to_insert->paired_value.first)) {
-                return std::make_pair(Iterator(m_elements[start_idx]), false);
-            }
-            size_type step_num = 1;
-            for (free_idx = CollisionPolicy::next(start_idx, step_num++, m_elements.size());
-                 m_states[free_idx] == DEFINED;
-                 free_idx = CollisionPolicy::next(free_idx, step_num++, m_elements.size())) {
-                if (free_idx == start_idx ||
-                    m_equal(m_elements[free_idx]->paired_value.first, to_insert->paired_value.first)) {
-                    return std::make_pair(Iterator(m_elements[free_idx]), false);
-                }
-            }
-        }
-        to_insert->idx = free_idx;
-
-        std::shared_ptr<Node> prev = (hint == m_end ? m_last : hint->prev);
-        if (prev != nullptr) {
-            prev->next = to_insert;
-        } else { // если перед элементом никого, то он должен быть начальным
-            m_begin = to_insert;
-        }
-        to_insert->prev = prev;
-        if (hint != m_end) {
-            hint->prev = to_insert;
-        } else { // если после элемента никого, то он последний
-            m_last = to_insert;
-        }
-        to_insert->next = hint;
-
-        m_elements[free_idx] = to_insert;
-        m_states[free_idx] = DEFINED;
-        ++m_size;
-
-        if (load_factor() > 0.5) {
-            rehash(m_elements.size());
-        }
-        return std::make_pair(Iterator(to_insert), true);
+#ifdef OAH_STATS
+    // probe lengths, clusters and rehashes of the table, see TableStats
+    TableStats stats() const {
+        return m_table.stats();
     }
 
-    iterator erase_by_idx(size_type to_erase_idx) {
-        if (m_states[to_erase_idx] != DEFINED) {
-            return Iterator(m_end);
-        }
-        std::shared_ptr<Node> to_erase = m_elements[to_erase_idx];
-        if (to_erase->next != nullptr) {
-            to_erase->next->prev = to_erase->prev;
-        } else {
-            m_last = to_erase->prev;
-        }
-
-        if (to_erase->prev != nullptr) {
-            to_erase->prev->next = to_erase->next;
-        } else {
-            m_begin = to_erase->next;
-        }
-
-        m_states[to_erase_idx] = DELETED;
-
-        auto next = to_erase->next;
-        m_elements[to_erase_idx] = nullptr;
-        --m_size;
-        return Iterator(next);
+    void reset_stats() {
+        m_table.reset_stats();
     }
+#endif
 
-    const hasher &m_hash;
-    const key_equal &m_equal;
-    std::vector<std::shared_ptr<Node> > m_elements;
-
-    std::vector<State> m_states;
-    std::shared_ptr<Node> m_begin;
-    std::shared_ptr<Node> m_last;
-    std::shared_ptr<Node> m_end;
-
-
-    size_type m_size;
-
-    struct Node {
-
-        value_type paired_value;
-
-        size_type idx;
-        std::shared_ptr<Node> prev, next;
-
-        template<class...Args>
-        Node(Args &&...args)
-                : paired_value(std::forward<Args>(args)...) {
-            init_rest();
-        }
-
-
-        void init_rest(size_type i = UINT32_MAX, std::shared_ptr<Node> p = nullptr, std::shared_ptr<Node> n = nullptr) {
-            idx = i;
-            prev = p;
-            next = n;
-        }
-
-        ~Node() = default;
-    };
-
-
-    class Iterator :
-            public std::iterator<std::forward_iterator_tag, value_type, difference_type,
-                    pointer, reference> {
-
-        friend class ConstIterator;
-
-        friend class HashMap;
-
-        std::shared_ptr<Node> data;
+private:
+    friend struct SerializationAccess;
 
-        Iterator(const std::shared_ptr<Node> &to_construct) {
-            data = to_construct;
-        }
+    Table m_table;
 
-    public:
+    // ranges inserted in parallel: random access, with elements whose key is read in place
+    template<class It>
+    static constexpr auto parallel_range(int) -> decltype(std::declval<It>()->first, bool()) {
+        return std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category> &&
+               std::is_same_v<std::decay_t<decltype(std::declval<It>()->first)>, key_type>;
+    }
 
+    template<class It>
+    static constexpr bool parallel_range(...) {
+        return false;
+    }
 
-        Iterator(const Iterator &it) {
-            data = it.data;
-        }
+    std::pair<iterator, bool> wrap(std::pair<size_type, bool> res) {
+        return std::make_pair(m_table.make_iterator(res.first), res.second);
+    }
 
-        Iterator operator++() {
-            data = data == nullptr ? nullptr : data->next;
-            return *this;
+    template<class K>
+    size_type erase_key(const K &key) {
+        size_type idx = m_table.find_index(key);
+        if (idx != npos) {
+            m_table.erase_by_idx(idx);
+            return 1;
         }
+        return 0;
+    }
 
-        Iterator operator++(int) {
-            Iterator *res = this;
-            data = data == nullptr ? nullptr : data->next;
-            return *res;
+    template<class K>
+    size_type existing_index(const K &key) const {
+        size_type idx = m_table.find_index(key);
+        if (idx == npos) {
+            throw std::out_of_range("HashMap::at");
         }
+        return idx;
+    }
 
-        reference operator*() {
-            return data->paired_value;
-        }
+    template<class A>
+    static constexpr bool is_key = std::is_same_v<std::remove_cv_t<std::remove_reference_t<A>>, Key>;
 
-        pointer operator->() const {
-            return &data->paired_value;
-        }
+    template<class K, class... Args>
+    std::pair<size_type, bool> try_emplace_impl(size_type hint, K &&key, Args &&... args) {
+        return m_table.emplace_by_hint(hint, key,
+                                       std::piecewise_construct,
+                                       std::forward_as_tuple(std::forward<K>(key)),
+                                       std::forward_as_tuple(std::forward<Args>(args)...));
+    }
 
-        friend bool operator==(const Iterator l, const Iterator r) {
-            return l.data == r.data;
+    template<class K, class M>
+    std::pair<size_type, bool> assign_impl(size_type hint, K &&key, M &&value) {
+        auto res = m_table.emplace_by_hint(hint, key, std::forward<K>(key), std::forward<M>(value));
+        if (!res.second) {
+            m_table.value_at(res.first).second = std::forward<M>(value);
         }
+        return res;
+    }
 
-        friend bool operator!=(const Iterator l, const Iterator r) {
-            return l.data != r.data;
-        }
+    // the key is looked up before anything is constructed when it can be taken from the
+    // arguments as is: a key and a mapped value, a pair or a piecewise key tuple
+    template<class... Args>
+    std::pair<size_type, bool> emplace_impl(size_type hint, Args &&... args) {
+        return m_table.insert_by_hint(hint, value_type(std::forward<Args>(args)...));
+    }
 
-        Iterator &operator=(Iterator &it) {
-            data = it.data;
-            return *this;
+    template<class A, class B>
+    std::pair<size_type, bool> emplace_impl(size_type hint, A &&key, B &&mapped) {
+        if constexpr (is_key<A>) {
+            return m_table.emplace_by_hint(hint, key, std::forward<A>(key), std::forward<B>(mapped));
+        } else {
+            return m_table.insert_by_hint(hint, value_type(std::forward<A>(key), std::forward<B>(mapped)));
         }
+    }
 
-        Iterator &operator=(Iterator &&it) {
-            data = it.data;
-            return *this;
+    template<class P>
+    std::pair<size_type, bool> emplace_impl(size_type hint, P &&pair) {
+        if constexpr (is_pair<std::remove_cv_t<std::remove_reference_t<P>>>::value) {
+            if constexpr (is_key<decltype((pair.first))>) {
+                return m_table.emplace_by_hint(hint, pair.first, std::forward<P>(pair));
+            } else {
+                return m_table.insert_by_hint(hint, value_type(std::forward<P>(pair)));
+            }
+        } else {
+            return m_table.insert_by_hint(hint, value_type(std::forward<P>(pair)));
         }
+    }
 
-        friend typename std::iterator_traits<Iterator>::difference_type distance(Iterator &first, Iterator &last) {
-            typename std::iterator_traits<Iterator>::difference_type cnt = 0;
-            for (auto it = first; it != last; ++it, ++cnt);
-            return cnt;
+    template<class K, class Tuple>
+    std::pair<size_type, bool> emplace_impl(size_type hint, std::piecewise_construct_t,
+                                            std::tuple<K> key, Tuple &&mapped) {
+        if constexpr (is_key<K>) {
+            return m_table.emplace_by_hint(hint, std::get<0>(key),
+                                           std::piecewise_construct, std::move(key), std::forward<Tuple>(mapped));
+        } else {
+            return m_table.insert_by_hint(hint, value_type(std::piecewise_construct,
+                                                           std::move(key), std::forward<Tuple>(mapped)));
         }
+    }
 
-        friend typename std::iterator_traits<Iterator>::difference_type
-        distance(const Iterator &first, const Iterator &last) {
-            typename std::iterator_traits<Iterator>::difference_type cnt = 0;
-            for (auto it = first; it != last; ++it, ++cnt);
-            return cnt;
-        }
+    template<class>
+    struct is_pair : std::false_type {
     };
 
-    class ConstIterator :
-            public std::iterator<std::forward_iterator_tag, const value_type, difference_type,
-                    const value_type *, const value_type &> {
-
-        friend class Iterator;
-
-        friend class HashMap;
-
-        std::shared_ptr<Node> data;
-
-        ConstIterator(const std::shared_ptr<Node> &node) {
-            data = node;
-        }
-
-
-    public:
-
-        ConstIterator(const ConstIterator &it) {
-            data = it.data;
-        }
-
-        ConstIterator(const Iterator it) {
-            data = it.data;
-        }
-
-        ConstIterator operator++() {
-            data = data == nullptr ? nullptr : data->next;
-            return *this;
-        }
-
-        const value_type &operator*() const {
-            return data->paired_value;
-        }
-
-        value_type const *operator->() const {
-            return &data->paired_value;
-        }
-
-        friend bool operator==(const ConstIterator &l, const ConstIterator &r) {
-            return l.data == r.data;
-        }
-
-        friend bool operator!=(const ConstIterator &l, const ConstIterator &r) {
-            return l.data != r.data;
-        }
-
-        ConstIterator &operator=(ConstIterator &it) {
-            data = it.data;
-            return *this;
-        }
-
-        friend typename std::iterator_traits<ConstIterator>::difference_type
-        distance(const ConstIterator &first, const ConstIterator &last) {
-            typename std::iterator_traits<Iterator>::difference_type cnt = 0;
-            for (auto it = first; it != last; ++it, ++cnt);
-            return cnt;
-        }
+    template<class A, class B>
+    struct is_pair<std::pair<A, B>> : std::true_type {
     };
 };
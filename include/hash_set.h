@@ -1,21 +1,40 @@
 #pragma once
 
+#include "hash_table.h"
 #include "policy.h"
-#include <vector>
+#include "thread_executor.h"
 #include <functional>
-#include <iostream>
-#include "identical_functions.inl"
+#include <iterator>
+#include <memory>
+#include <type_traits>
 
 template<
         class Key,
         class CollisionPolicy = LinearProbing,
         class Hash = std::hash<Key>,
-        class Equal = std::equal_to<Key>
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<Key>
 >
 class HashSet {
-    struct Node;
 
-    class Iterator;
+    struct KeyOf {
+        static const Key &get(const Key &value) {
+            return value;
+        }
+    };
+
+    using Table = HashTable<Key, Key, KeyOf, CollisionPolicy, guarded_hash_t<Hash>, Equal, Reducer, GrowthPolicy, Allocator>;
+
+    static constexpr std::size_t npos = Table::npos;
+
+    // overloads taking other key types are enabled only for transparent Hash and Equal;
+    // iterators are excluded so that erase(iterator) is not taken for a key
+    template<class K>
+    using transparent_key = std::enable_if_t<is_transparent_lookup<Hash, Equal>::value &&
+                                             !std::is_convertible_v<const K &, typename Table::const_iterator> &&
+                                             !std::is_convertible_v<const K &, typename Table::iterator>, K>;
 
 public:
     // types
@@ -23,142 +42,136 @@ public:
     using value_type = Key;
     using size_type = std::size_t;
     using difference_type = std::ptrdiff_t;
-    using hasher = Hash;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
     using key_equal = Equal;
+    using allocator_type = Allocator;
     using reference = value_type &;
     using const_reference = const value_type &;
     using pointer = value_type *;
     using const_pointer = const value_type *;
 
-    using iterator = Iterator;
-    using const_iterator = Iterator;
-
+    using iterator = typename Table::const_iterator;
+    using const_iterator = typename Table::const_iterator;
 
     explicit HashSet(size_type expected_max_size = 1,
                      const hasher &hash = hasher(),
-                     const key_equal &equal = key_equal()) : m_hash(hash), m_equal(equal) {
-        m_capacity = expected_max_size * 2;
-        m_elements = std::vector<Node *>(m_capacity, nullptr);
-        m_states = std::vector<State>(m_capacity, UNDEFINED);
-//        for (size_type i = 0; i < m_capacity; ++i) {
-//            m_elements[i] = nullptr;
-//            m_states[i] = UNDEFINED;
-//        }
-        m_end = nullptr;
-        m_begin = m_end;
-        m_last = m_begin;
-        m_size = 0;
-    }
+                     const key_equal &equal = key_equal(),
+                     const allocator_type &alloc = allocator_type()) : m_table(expected_max_size, hash, equal, alloc) {}
+
+    explicit HashSet(const allocator_type &alloc) : HashSet(1, hasher(), key_equal(), alloc) {}
 
     template<class InputIt>
     HashSet(InputIt first, InputIt last,
             size_type expected_max_size = 1,
             const hasher &hash = hasher(),
-            const key_equal &equal = key_equal()) : HashSet(expected_max_size, hash, equal) {
-        for (auto it = first; it != last; ++it) {
-            insert(std::forward<value_type>(*it));
-        }
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type()) : HashSet(expected_max_size, hash, equal, alloc) {
+        insert(first, last);
     }
 
-    HashSet(const HashSet &hs) : HashSet(hs.m_capacity / 2, hs.m_hash, hs.m_equal) {
-        for (const_iterator it = hs.begin(); it != hs.end(); ++it) {
-            emplace(*it);
-        }
+    // builds the container in parallel, see insert(first, last, executor)
+    template<class InputIt, class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    HashSet(InputIt first, InputIt last, Executor &&executor,
+            size_type expected_max_size = 1,
+            const hasher &hash = hasher(),
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type()) : HashSet(expected_max_size, hash, equal, alloc) {
+        insert(first, last, executor);
     }
 
-    HashSet(HashSet &&hs) noexcept : HashSet(hs.m_capacity / 2, hs.m_hash, hs.m_equal) {
-        std::vector<Node *> to_move;
-        for (auto it = hs.begin(); it != hs.end(); ++it) {
-            to_move.push_back(it.data);
-        }
-        for (size_type i = 0; i < hs.m_capacity; ++i) {
-            if (hs.m_elements[i] != nullptr) {
-                hs.m_elements[i]->init_rest();
-            }
-            hs.m_elements[i] = nullptr;
-        }
-        for (size_type i = 0; i < to_move.size(); ++i) {
-            insert_by_hint(m_end, to_move[i]);
-        }
-        hs.m_begin = hs.m_last = hs.m_end = nullptr;
-        hs.clear();
-    }
+    HashSet(const HashSet &hs) = default;
+
+    HashSet(const HashSet &hs, const allocator_type &alloc) : m_table(hs.m_table, alloc) {}
+
+    HashSet(HashSet &&hs) noexcept = default;
 
     HashSet(std::initializer_list<value_type> init,
             size_type expected_max_size = 1,
             const hasher &hash = hasher(),
-            const key_equal &equal = key_equal()) : HashSet(init.begin(), init.end(), expected_max_size, hash, equal) {}
+            const key_equal &equal = key_equal(),
+            const allocator_type &alloc = allocator_type())
+            : HashSet(init.begin(), init.end(), expected_max_size, hash, equal, alloc) {}
 
     HashSet &operator=(const HashSet &) = default;
 
     HashSet &operator=(HashSet &&) noexcept = default;
 
     HashSet &operator=(std::initializer_list<value_type> init) {
-        this(init, init.size());
-    }
-
-    ~HashSet() {
-        erase(begin(), end());
+        clear();
+        reserve(init.size());
+        insert(init);
+        return *this;
     }
 
     iterator begin() noexcept {
-        return iterator(m_begin);
+        return cbegin();
     }
 
     const_iterator begin() const noexcept {
-        return const_iterator(m_begin);
+        return m_table.begin();
     }
 
     const_iterator cbegin() const noexcept {
-        return const_iterator(m_begin);
+        return m_table.begin();
     }
 
     iterator end() noexcept {
-        return iterator(m_end);
+        return cend();
     }
 
     const_iterator end() const noexcept {
-        return const_iterator(m_end);
+        return m_table.end();
     }
 
     const_iterator cend() const noexcept {
-        return const_iterator(m_end);
+        return m_table.end();
     }
 
     bool empty() const {
-        return m_size == 0;
+        return m_table.size() == 0;
     }
 
     size_type size() const {
-        return m_size;
+        return m_table.size();
+    }
+
+    // the hasher giving the hashes the precomputed-hash overloads take, which is not Hash
+    // itself when Hash is weak
+    hasher hash_function() const {
+        return m_table.hash_function();
+    }
+
+    key_equal key_eq() const {
+        return m_table.key_eq();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
     }
 
     size_type max_size() const {
-        return m_capacity;
+        return m_table.capacity();
     }
 
     void clear() {
-        erase(begin(), end());
-        m_elements.clear();
-        m_states.clear();
-        delete m_begin;
-        m_size = 0;
+        m_table.clear();
     }
 
     std::pair<iterator, bool> insert(const value_type &key) {
-        return insert_by_hint(m_end, new Node(std::forward<const value_type>(key)));
+        return wrap(m_table.insert_by_hint(npos, key));
     }
 
     std::pair<iterator, bool> insert(value_type &&key) {
-        return insert_by_hint(m_end, new Node(std::forward<value_type>(key)));
+        return wrap(m_table.insert_by_hint(npos, std::move(key)));
     }
 
     iterator insert(const_iterator hint, const value_type &key) {
-        return insert_by_hint(hint.data, new Node(std::forward<const value_type>(key))).first;
+        return wrap(m_table.insert_by_hint(hint.index(), key)).first;
     }
 
     iterator insert(const_iterator hint, value_type &&key) {
-        return insert_by_hint(hint.data, new Node(std::move(key)));
+        return wrap(m_table.insert_by_hint(hint.index(), std::move(key))).first;
     }
 
     template<class InputIt>
@@ -168,111 +181,186 @@ public:
         }
     }
 
+    // The same result with the tasks of executor (ThreadExecutor or any callable satisfying
+    // is_executor) when the range is random access and its elements are key_type.
+    template<class InputIt, class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    void insert(InputIt first, InputIt last, Executor &&executor) {
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category> &&
+                      std::is_same_v<typename std::iterator_traits<InputIt>::value_type, key_type>) {
+            m_table.insert_parallel(first, last, [](const key_type &key) -> const key_type & { return key; }, executor);
+        } else {
+            insert(first, last);
+        }
+    }
+
     void insert(std::initializer_list<value_type> init) {
         insert(init.begin(), init.end());
     }
 
+    // hash must be hash_function()(key) for the key of value, not the raw output of Hash
+    std::pair<iterator, bool> insert_with_hash(const value_type &value, size_type hash) {
+        return wrap(m_table.emplace_with_hash(npos, value, hash, value));
+    }
+
+    std::pair<iterator, bool> insert_with_hash(value_type &&value, size_type hash) {
+        return wrap(m_table.emplace_with_hash(npos, value, hash, std::move(value)));
+    }
+
     // construct element in-place, no copy or move operations are performed;
     // element's constructor is called with exact same arguments as `emplace` method
     // (using `std::forward<Args>(args)...`)
     template<class... Args>
     std::pair<iterator, bool> emplace(Args &&... args) {
-        auto to_emplace = new Node(std::forward<Args>(args)...);
-        return insert_by_hint(m_end, to_emplace);
+        return wrap(emplace_impl(npos, std::forward<Args>(args)...));
     }
 
     template<class... Args>
     iterator emplace_hint(const_iterator hint, Args &&... args) {
-        return insert_by_hint(hint.data, new Node(std::forward<Args>(args)...)).first;
+        return wrap(emplace_impl(hint.index(), std::forward<Args>(args)...)).first;
     }
 
     iterator erase(const_iterator pos) {
-        return pos.data == m_end ? end() : erase_by_idx(pos.data->idx);
+        return pos == end() ? end() : m_table.make_iterator(m_table.erase_by_idx(pos.index()));
     }
 
     iterator erase(const_iterator first, const_iterator last) {
-        std::vector<size_type> to_erase;
-        for (auto it = first; it != last; ++it) {
-            to_erase.push_back(it.data->idx);
-        }
-        iterator last_erased = iterator(m_end);
-        for (auto idx : to_erase) {
-            last_erased = erase_by_idx(idx);
+        // erasing may move the elements after first, so last cannot be compared against
+        for (auto n = std::distance(first, last); n > 0; --n) {
+            first = erase(first);
         }
-        to_erase.clear();
-
-        return last_erased;
+        return m_table.make_iterator(first.index());
     }
 
     size_type erase(const key_type &key) {
-        size_type to_erase_idx = m_hash(key) % m_capacity;
-        if (m_states[to_erase_idx] == DEFINED) {
-            erase_by_idx(to_erase_idx);
-            return 1;
-        }
-        return 0;
+        return erase_key(key);
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type erase(const K &key) {
+        return erase_key(key);
     }
 
     // exchanges the contents of the container with those of other;
     // does not invoke any move, copy, or swap operations on individual elements
     void swap(HashSet &&other) noexcept {
-        std::swap(m_elements, other.m_elements);
-        std::swap(m_states, other.m_states);
-        std::swap(m_size, other.m_size);
-        std::swap(m_capacity, other.m_capacity);
-        std::swap(m_begin, other.m_begin);
-        std::swap(m_last, other.m_last);
-        std::swap(m_end, other.m_end);
+        m_table.swap(other.m_table);
+    }
+
+    void swap(HashSet &other) noexcept {
+        m_table.swap(other.m_table);
     }
 
     size_type count(const key_type &key) const {
-        return find(key).data == m_end ? 0 : 1;
+        return m_table.find_index(key) == npos ? 0 : 1;
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type count(const K &key) const {
+        return m_table.find_index(key) == npos ? 0 : 1;
     }
 
     iterator find(const key_type &key) {
-        size_type start_idx = m_hash(key) % m_capacity;
-        if (m_states[start_idx] == DEFINED && m_equal(key, m_elements[start_idx]->value)) {
-            return iterator(m_elements[start_idx]);
-        }
-        for (size_type step_num = 1, idx = CollisionPolicy::next(start_idx, step_num++, m_capacity);
-             m_states[idx] != UNDEFINED;
-             idx = CollisionPolicy::next(idx, step_num++, m_capacity)) {
-            if (m_states[idx] == DEFINED && m_equal(m_elements[idx]->value, key)) {
-                return iterator(m_elements[idx]);
-            }
-        }
-        return iterator(m_end);
+        return m_table.make_iterator(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    iterator find(const K &key) {
+        return m_table.make_iterator(m_table.find_index(key));
     }
 
     const_iterator find(const key_type &key) const {
-        size_type start_idx = m_hash(key) % m_capacity;
-        if (m_states[start_idx] == DEFINED && m_equal(key, m_elements[start_idx]->value)) {
-            return const_iterator(m_elements[start_idx]);
-        }
-        for (size_type step_num = 1, idx = CollisionPolicy::next(start_idx, step_num++, m_capacity);
-             m_states[idx] != UNDEFINED;
-             idx = CollisionPolicy::next(idx, step_num++, m_capacity)) {
-            if (m_states[idx] == DEFINED && m_equal(m_elements[idx]->value, key)) {
-                return const_iterator(m_elements[idx]);
-            }
-        }
-        return const_iterator(m_end);
+        return m_table.make_iterator(m_table.find_index(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key) const {
+        return m_table.make_iterator(m_table.find_index(key));
     }
 
     bool contains(const key_type &key) const {
-        return find(key).data != m_end;
+        return m_table.find_index(key) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key) const {
+        return m_table.find_index(key) != npos;
+    }
+
+    // batched lookups writing an iterator (or a flag) per key of [first, last) to out;
+    // memory accesses of up to 16 keys are overlapped
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = m_table.make_iterator(idx);
+        });
+        return out;
+    }
+
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = m_table.make_iterator(idx);
+        });
+        return out;
+    }
+
+    template<class ForwardIt, class OutputIt>
+    OutputIt contains_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        m_table.find_many(first, last, [&](size_type idx) {
+            *out++ = idx != npos;
+        });
+        return out;
+    }
+
+    // lookups by a precomputed hash, which must be hash_function()(key): Hash is wrapped in a
+    // finalizer when it is weak (see guarded_hash_t), so hashing with Hash{} misses the keys
+    iterator find(const key_type &key, size_type hash) {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    const_iterator find(const key_type &key, size_type hash) const {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    template<class K, class = transparent_key<K>>
+    iterator find(const K &key, size_type hash) {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key, size_type hash) const {
+        return m_table.make_iterator(m_table.find_index(key, hash));
+    }
+
+    bool contains(const key_type &key, size_type hash) const {
+        return m_table.find_index(key, hash) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key, size_type hash) const {
+        return m_table.find_index(key, hash) != npos;
     }
 
     std::pair<iterator, iterator> equal_range(const key_type &key) {
         iterator found = find(key);
-        return (found.data == m_end ? std::make_pair(Iterator(m_end), Iterator(m_end)) : std::make_pair(found, Iterator(
-                found.data->next)));
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
+    }
+
+    template<class K, class = transparent_key<K>>
+    std::pair<iterator, iterator> equal_range(const K &key) {
+        iterator found = find(key);
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
     }
 
     std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const {
         const_iterator found = find(key);
-        return (found.data == m_end ? std::make_pair(const_iterator(m_end), const_iterator(m_end))
-                                    : std::make_pair(found, const_iterator(found.data->next)));
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
+    }
+
+    template<class K, class = transparent_key<K>>
+    std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+        const_iterator found = find(key);
+        return found == end() ? std::make_pair(found, found) : std::make_pair(found, std::next(found));
     }
 
     size_type bucket_count() const {
@@ -280,54 +368,47 @@ public:
     }
 
     size_type max_bucket_count() const {
-        return m_capacity;
+        return m_table.capacity();
     }
 
     size_type bucket_size(const size_type n) const {
-        return m_elements[n] == nullptr ? 0 : 1;
+        return m_table.is_defined(n) ? 1 : 0;
     }
 
     size_type bucket(const key_type &key) const {
-        auto found = find(key);
-        return found.data == m_end ? 0 : found.data->idx;
+        size_type idx = m_table.find_index(key);
+        return idx == npos ? 0 : idx;
     }
 
     float load_factor() const {
-        return static_cast<float>(m_size) / static_cast<float>(bucket_count());
+        return bucket_count() == 0 ? 0.0f : static_cast<float>(size()) / static_cast<float>(bucket_count());
     }
 
     float max_load_factor() const {
-        return m_size > 0 ? 1.0f : 0.0f;
+        return m_table.max_load_factor();
+    }
+
+    void max_load_factor(float ml) {
+        m_table.max_load_factor(ml);
     }
 
     void rehash(const size_type count) {
-        if (count > m_capacity / 2) {
-            std::vector<Node *> tmp(m_elements);
-            m_capacity = count * 2;
-            m_elements.clear();
-            m_states.clear();
-            m_elements.resize(m_capacity);
-            m_states.resize(m_capacity);
-            m_begin = m_last = m_end;
-            m_size = 0;
-            for (auto it:tmp) {
-                if (it != nullptr) {
-                    it->init_rest();
-                    insert_by_hint(m_end, it);
-                }
-            }
-        }
+        m_table.rehash(count);
+    }
+
+    // moves the elements with the tasks of executor
+    template<class Executor, class = std::enable_if_t<is_executor<Executor>::value>>
+    void rehash(const size_type count, Executor &&executor) {
+        m_table.rehash(count, executor);
     }
 
     void reserve(size_type count) {
-        if (count > m_capacity / 2) {
-            rehash(count);
-        }
+        m_table.rehash(count);
     }
 
     // compare two containers contents
     friend bool operator==(const HashSet &lhs, const HashSet &rhs) {
-        if (lhs.m_size != rhs.m_size) {
+        if (lhs.size() != rhs.size()) {
             return false;
         }
         for (auto it = lhs.begin(); it != lhs.end(); ++it) {
@@ -339,185 +420,51 @@ public:
     }
 
     friend bool operator!=(const HashSet &lhs, const HashSet &rhs) {
-        return !(lhs.m_set == rhs.m_set);
+        return !(lhs == rhs);
     }
 
-private:
-    enum State {
-        UNDEFINED, DEFINED, DELETED
-    };
-
-    size_type m_size;
-    std::vector<Node *> m_elements;
-    std::vector<State> m_states;
-    size_type m_capacity;
-    const hasher &m_hash;
-    const key_equal &m_equal;
-    Node *m_begin;
-    Node *m_last;
-    Node *m_end;
-
-    std::pair<iterator, bool> insert_by_hint(Node *hint, Node *to_insert) {
-        if (m_capacity < 2) {
-            reserve(1);
-        }
-        size_type start_idx = m_hash(to_insert->value) % m_capacity;
-        size_type free_idx;
-        if (m_states[start_idx] == UNDEFINED ||
-            m_states[start_idx] == DELETED) {
-            free_idx = start_idx;
-        } else {
-            if (m_equal(m_elements[start_idx]->value, to_insert->value)) {
-                delete to_insert;
-                return std::make_pair(Iterator(m_elements[start_idx]), false);
-            } else {
-                size_type step_num = 1;
-                for (free_idx = CollisionPolicy::next(start_idx, step_num++, m_capacity);
-                     m_states[free_idx] == DEFINED;
-                     free_idx = CollisionPolicy::next(free_idx, step_num++, m_capacity)) {
-                    if (free_idx == start_idx || m_equal(m_elements[free_idx]->value, to_insert->value)) {
-                        delete to_insert;
-                        return std::make_pair(Iterator(m_elements[free_idx]), false);
-                    }
-                }
-            }
-        }
-        to_insert->idx = free_idx;
-
-        Node *prev = (hint == m_end ? m_last : hint->prev);
-        if (prev != nullptr) {
-            prev->next = to_insert;
-        } else { // если перед элементом никого, то он должен быть начальным
-            m_begin = to_insert;
-        }
-        to_insert->prev = prev;
-        if (hint != m_end) {
-            hint->prev = to_insert;
-        } else { // если после элемента никого, то он последний
-            m_last = to_insert;
-        }
-        to_insert->next = hint;
-
-        m_elements[free_idx] = to_insert;
-        m_states[free_idx] = DEFINED;
-        ++m_size;
-
-        if (load_factor() > 0.5) {
-            rehash(m_capacity);
-        }
-        return std::make_pair(iterator(to_insert), true);
+#ifdef OAH_STATS
+    // probe lengths, clusters and rehashes of the table, see TableStats
+    TableStats stats() const {
+        return m_table.stats();
     }
 
-    iterator erase_by_idx(size_type to_erase_idx) {
-        if (m_states[to_erase_idx] != DEFINED) {
-            return iterator(m_end);
-        }
-        Node *to_erase = m_elements[to_erase_idx];
-        if (to_erase->next != nullptr) {
-            to_erase->next->prev = to_erase->prev;
-        } else {
-            m_last = to_erase->prev;
-        }
-
-        if (to_erase->prev != nullptr) {
-            to_erase->prev->next = to_erase->next;
-        } else {
-            m_begin = to_erase->next;
-        }
-
-        m_states[to_erase_idx] = DELETED;
-
-        auto next = to_erase->next;
-        delete to_erase;
-        m_elements[to_erase_idx] = nullptr;
-        --m_size;
-        return iterator(next);
+    void reset_stats() {
+        m_table.reset_stats();
     }
+#endif
 
-    struct Node {
-        Key value;
-
-        size_type idx;
-        Node *prev, *next;
-
-        template<class...Args>
-        Node(Args &&...args)
-                :value(std::forward<Args>(args)...) {
-            init_rest();
-        }
-
-        Node(Node *other) : value(std::forward<Key &>(other->value)) {
-            init_rest();
-        }
-
-        void init_rest(size_type i = UINT32_MAX, Node *p = nullptr, Node *n = nullptr) {
-            idx = i;
-            prev = p;
-            next = n;
-        }
-
-        ~Node() {}
-    };
-
-    class Iterator : public std::iterator<std::forward_iterator_tag, value_type, difference_type,
-            pointer, reference> {
-
-        friend class HashSet;
-
-        Node *data;
-
-        Iterator(Node *node) {
-            data = node;
-        }
-
-    public:
-        Iterator(const Iterator &it) {
-            data = it.data;
-        }
-
-        Iterator(Iterator &&) = default;
-
-        Iterator operator++() {
-            data = data->next;
-            return *this;
-        }
-
-        Iterator operator++(int) {
-            auto res = *this;
-            data = data->next;
-            return res;
-        }
-
-        const value_type &operator*() const {
-            return data->value;
-        }
-
-        value_type const *operator->() const {
-            return &data->value;
-        }
+private:
+    friend struct SerializationAccess;
 
-        friend bool operator==(const Iterator &l, const Iterator &r) {
-            return l.data == r.data;
-        }
+    Table m_table;
 
-        friend bool operator!=(const Iterator &l, const Iterator &r) {
-            return l.data != r.data;
-        }
+    std::pair<iterator, bool> wrap(std::pair<size_type, bool> res) const {
+        return std::make_pair(m_table.make_iterator(res.first), res.second);
+    }
 
-        Iterator &operator=(Iterator &&it) noexcept {
-            data = it.data;
-            return *this;
+    template<class K>
+    size_type erase_key(const K &key) {
+        size_type idx = m_table.find_index(key);
+        if (idx != npos) {
+            m_table.erase_by_idx(idx);
+            return 1;
         }
+        return 0;
+    }
 
-        Iterator &operator=(const Iterator &it) noexcept {
-            data = it.data;
-            return *this;
-        }
+    // a key passed as is is looked up before it is copied, anything else is converted first
+    template<class... Args>
+    std::pair<size_type, bool> emplace_impl(size_type hint, Args &&... args) {
+        return m_table.insert_by_hint(hint, value_type(std::forward<Args>(args)...));
+    }
 
-        typename std::iterator_traits<Iterator>::difference_type distance(const Iterator &first, const Iterator &last) {
-            typename std::iterator_traits<Iterator>::difference_type cnt = 0;
-            for (auto it = first; it != last; ++it, ++cnt);
-            return cnt;
+    template<class A>
+    std::pair<size_type, bool> emplace_impl(size_type hint, A &&arg) {
+        if constexpr (std::is_same_v<std::remove_cv_t<std::remove_reference_t<A>>, Key>) {
+            return m_table.emplace_by_hint(hint, arg, std::forward<A>(arg));
+        } else {
+            return m_table.insert_by_hint(hint, value_type(std::forward<A>(arg)));
         }
-    };
+    }
 };
@@ -0,0 +1,1800 @@
+#pragma once
+
+#include "group.h"
+#include "hashers.h"
+#include "policy.h"
+#include "table_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Lookups accept any key type once both the hasher and the key comparator declare is_transparent.
+template<class Hash, class Equal, class = void>
+struct is_transparent_lookup : std::false_type {
+};
+
+template<class Hash, class Equal>
+struct is_transparent_lookup<Hash, Equal, std::void_t<typename Hash::is_transparent, typename Equal::is_transparent>>
+        : std::true_type {
+};
+
+// A hasher wrapped into StoredHash makes the table keep the full hash of every element: rehashing
+// never calls the hasher again and the key comparator is called only for equal hashes.
+template<class Hash>
+struct StoredHash : Hash {
+    static constexpr bool store_hash = true;
+
+    StoredHash() = default;
+
+    StoredHash(const Hash &hash) : Hash(hash) {}
+
+    // from a stored hasher of another type, such as the one guarded_hash_t replaced
+    template<class Other, class = std::enable_if_t<std::is_constructible_v<Hash, const Other &>>>
+    StoredHash(const StoredHash<Other> &hash) : Hash(static_cast<const Other &>(hash)) {}
+};
+
+template<class Hash, class = void>
+struct is_hash_stored : std::false_type {
+};
+
+template<class Hash>
+struct is_hash_stored<Hash, std::void_t<decltype(Hash::store_hash)>>
+        : std::integral_constant<bool, Hash::store_hash> {
+};
+
+// a weak hasher is finalized before its hashes are stored
+template<class Hash>
+struct guarded_hash<StoredHash<Hash>> {
+    using type = StoredHash<guarded_hash_t<Hash>>;
+};
+
+// Open addressing core shared by the containers: values are stored inline in a
+// contiguous slot array, a parallel array of control bytes keeps the state and a
+// 7-bit hash tag of every slot, iteration order is kept by index links.
+template<
+        class Key,
+        class Value,
+        class KeyOf,
+        class CollisionPolicy,
+        class Hash,
+        class Equal,
+        class Reducer,
+        class GrowthPolicy,
+        class Allocator
+>
+class HashTable {
+    static_assert(!Reducer::power_of_two || GrowthPolicy::power_of_two,
+                  "the reducer needs a growth policy producing power of two capacities");
+    static_assert(!needs_power_of_two<CollisionPolicy>::value || GrowthPolicy::power_of_two,
+                  "the collision policy only covers power of two capacities");
+    static_assert(!is_slot_ordered<CollisionPolicy>::value || !is_incremental<GrowthPolicy>::value,
+                  "slot order iteration cannot follow the elements moved by an incremental resize");
+
+    // slots are linked in the iteration order unless the collision policy asks for slot order
+    static constexpr bool linked = !is_slot_ordered<CollisionPolicy>::value;
+
+    struct LinkedSlot;
+    struct PlainSlot;
+
+    using Slot = std::conditional_t<linked, LinkedSlot, PlainSlot>;
+
+    template<bool Const>
+    class Iterator;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    static constexpr float default_max_load_factor = 0.5f;
+
+    explicit HashTable(size_type expected_max_size,
+                       const hasher &hash,
+                       const key_equal &equal,
+                       const allocator_type &alloc) : m_hash(hash), m_equal(equal), m_alloc(alloc) {
+        if (expected_max_size > 0) {
+            rehash_impl(capacity_for(expected_max_size));
+        }
+    }
+
+    HashTable(const HashTable &other)
+            : HashTable(other, alloc_traits::select_on_container_copy_construction(other.m_alloc)) {}
+
+    HashTable(const HashTable &other, const allocator_type &alloc)
+            : HashTable(0, other.m_hash, other.m_equal, alloc) {
+        m_max_load = other.m_max_load;
+        if (other.m_capacity > 0) {
+            rehash_impl(other.m_capacity);
+        }
+        for (size_type i = other.first_index(); i != npos; i = other.next_index(i)) {
+            const Value &value = other.value_at(i);
+            emplace_with_hash(npos, KeyOf::get(value), other.slot_hash(i), value);
+        }
+    }
+
+    HashTable(HashTable &&other) noexcept : HashTable(0, other.m_hash, other.m_equal, other.m_alloc) {
+        steal(other);
+    }
+
+    HashTable &operator=(const HashTable &other) {
+        if (this != &other) {
+            HashTable tmp(other, alloc_traits::propagate_on_container_copy_assignment::value ? other.m_alloc : m_alloc);
+            release();
+            if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                m_alloc = other.m_alloc;
+            }
+            steal(tmp);
+        }
+        return *this;
+    }
+
+    HashTable &operator=(HashTable &&other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                                     alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        release();
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+            m_alloc = other.m_alloc;
+        } else if (!(m_alloc == other.m_alloc)) {
+            // the arrays of other cannot be freed with our allocator, so the elements are moved one by one
+            HashTable tmp(0, other.m_hash, other.m_equal, m_alloc);
+            tmp.m_max_load = other.m_max_load;
+            if (other.m_capacity > 0) {
+                tmp.rehash_impl(other.m_capacity);
+            }
+            for (size_type i = other.first_index(); i != npos; i = other.next_index(i)) {
+                tmp.insert_by_hint(npos, std::move(other.value_at(i)));
+            }
+            other.clear();
+            steal(tmp);
+            return *this;
+        }
+        steal(other);
+        return *this;
+    }
+
+    ~HashTable() {
+        release();
+    }
+
+    iterator begin() noexcept {
+        return make_iterator(first_index());
+    }
+
+    const_iterator begin() const noexcept {
+        return make_iterator(first_index());
+    }
+
+    iterator end() noexcept {
+        return make_iterator(npos);
+    }
+
+    const_iterator end() const noexcept {
+        return make_iterator(npos);
+    }
+
+    iterator make_iterator(size_type idx) noexcept {
+        if constexpr (incremental || !linked) {
+            return iterator(this, idx);
+        } else {
+            return iterator(m_slots, idx);
+        }
+    }
+
+    const_iterator make_iterator(size_type idx) const noexcept {
+        if constexpr (incremental || !linked) {
+            return const_iterator(this, idx);
+        } else {
+            return const_iterator(m_slots, idx);
+        }
+    }
+
+    size_type size() const {
+        return m_size;
+    }
+
+    size_type capacity() const {
+        return m_capacity;
+    }
+
+    const hasher &hash_function() const {
+        return m_hash;
+    }
+
+    const key_equal &key_eq() const {
+        return m_equal;
+    }
+
+    allocator_type get_allocator() const {
+        return m_alloc;
+    }
+
+    void clear() {
+        if constexpr (incremental) {
+            drop_old();
+        }
+        for (size_type i = first_index(); i != npos; i = next_index(i)) {
+            m_slots[i].value.~Value();
+        }
+        if (m_capacity > 0) {
+            std::fill_n(m_ctrl, m_capacity + group_width - 1, CTRL_EMPTY);
+        }
+        m_begin = m_last = npos;
+        m_size = 0;
+        m_deleted = 0;
+    }
+
+    // allocators are exchanged only if they propagate on swap, otherwise they must be equal
+    void swap(HashTable &other) noexcept {
+        steal(other);
+        if constexpr (alloc_traits::propagate_on_container_swap::value) {
+            std::swap(m_alloc, other.m_alloc);
+        }
+    }
+
+    template<class K>
+    size_type find_index(const K &key) const {
+        return m_size == 0 ? npos : find_index(key, m_hash(key));
+    }
+
+    // hash must be the value hash_function() gives for key
+    template<class K>
+    size_type find_index(const K &key, size_type hash) const {
+        if (m_size == 0) {
+            return npos;
+        }
+        const size_type idx = probe_for_key(key, hash);
+        if constexpr (incremental) {
+            if (idx == npos && m_old != nullptr) {
+                const size_type old_idx = m_old->find_index(key, hash);
+                return old_idx == npos ? npos : old_idx + m_capacity;
+            }
+        }
+        return idx;
+    }
+
+    // Looks up a range of keys in batches: all keys of a batch are hashed and their home slots
+    // prefetched before the first probe, so the cache misses of the batch overlap.
+    // on_result is called with the find_index result of every key in order.
+    template<class ForwardIt, class F>
+    void find_many(ForwardIt first, ForwardIt last, F on_result) const {
+        ForwardIt keys[lookup_batch];
+        size_type hashes[lookup_batch];
+        while (first != last) {
+            size_type n = 0;
+            for (; n < lookup_batch && first != last; ++n, ++first) {
+                keys[n] = first;
+                hashes[n] = m_hash(*first);
+                prefetch_home(hashes[n]);
+            }
+            for (size_type i = 0; i < n; ++i) {
+                on_result(find_index(*keys[i], hashes[i]));
+            }
+        }
+    }
+
+    // value is moved (or copied) into the table only if its key is absent
+    template<class V>
+    std::pair<size_type, bool> insert_by_hint(size_type hint, V &&value) {
+        return emplace_by_hint(hint, KeyOf::get(value), std::forward<V>(value));
+    }
+
+    // Constructs a value from args only if key, which must be the key of that value, is absent.
+    // A single probe both looks for the key and picks the slot for the new element.
+    template<class K, class... Args>
+    std::pair<size_type, bool> emplace_by_hint(size_type hint, const K &key, Args &&... args) {
+        return emplace_with_hash(hint, key, m_hash(key), std::forward<Args>(args)...);
+    }
+
+    // the same with the hash of key known in advance
+    template<class K, class... Args>
+    std::pair<size_type, bool> emplace_with_hash(size_type hint, const K &key, size_type hash, Args &&... args) {
+        if (m_capacity == 0) {
+            rehash_impl(capacity_for(1));
+        }
+        if constexpr (incremental) {
+            if (m_old != nullptr) {
+                hint = migrate(hint);
+                const size_type idx = m_old != nullptr ? m_old->find_index(key, hash) : npos;
+                if (idx != npos) {
+                    return std::make_pair(idx + m_capacity, false);
+                }
+            }
+        }
+        auto found = probe_for_insert(key, hash);
+        if (found.second) {
+            return std::make_pair(found.first, false);
+        }
+        m_tracked = hint;
+        const size_type idx = prepare_slot(hash, found.first);
+        hint = m_tracked;
+        m_tracked = npos;
+        try {
+            new(&m_slots[idx].value) Value(std::forward<Args>(args)...);
+        } catch (...) {
+            if constexpr (robin_hood) {
+                shift_back(idx);
+            }
+            throw;
+        }
+        if (m_ctrl[idx] == CTRL_DELETED) {
+            --m_deleted;
+        }
+        if constexpr (store_hash) {
+            m_hashes[idx] = hash;
+        }
+        set_ctrl(idx, hash_tag(hash));
+        link_before(idx, hint);
+        ++m_size;
+        return std::make_pair(idx, true);
+    }
+
+    // returns index of the element following the erased one;
+    // with backward shift erasing invalidates indices of the elements after it in the cluster
+    size_type erase_by_idx(size_type idx) {
+        if (!is_defined(idx)) {
+            return npos;
+        }
+        if constexpr (incremental) {
+            if (idx >= m_capacity) {
+                --m_size;
+                return migrate(evict_old(idx - m_capacity));
+            }
+        }
+        if constexpr (linked) {
+            m_tracked = m_slots[idx].next;
+            unlink(idx);
+        }
+        m_slots[idx].value.~Value();
+        --m_size;
+        if (erases_by_backward_shift<CollisionPolicy>::value) {
+            shift_back(idx);
+        } else {
+            set_ctrl(idx, CTRL_DELETED);
+            ++m_deleted;
+        }
+        if constexpr (!linked) {
+            m_tracked = next_full(idx + 1);
+        }
+        size_type next = m_tracked;
+        m_tracked = npos;
+        if constexpr (incremental) {
+            if (m_old != nullptr) {
+                next = migrate(next);
+            }
+        }
+        return next;
+    }
+
+    // while an incremental resize is in progress, the elements left in the old arrays follow
+    // the current ones with indices starting at capacity()
+    bool is_defined(size_type idx) const {
+        if constexpr (incremental) {
+            if (idx != npos && idx >= m_capacity) {
+                return m_old != nullptr && m_old->is_defined(idx - m_capacity);
+            }
+        }
+        return idx < m_capacity && is_full(m_ctrl[idx]);
+    }
+
+    size_type next_index(size_type idx) const {
+        if constexpr (incremental) {
+            if (idx >= m_capacity) {
+                return old_next(m_old->m_slots[idx - m_capacity].next);
+            }
+        }
+        if constexpr (linked) {
+            return m_slots[idx].next;
+        } else {
+            return next_full(idx + 1);
+        }
+    }
+
+    Value &value_at(size_type idx) {
+        if constexpr (incremental) {
+            if (idx >= m_capacity) {
+                return m_old->m_slots[idx - m_capacity].value;
+            }
+        }
+        return m_slots[idx].value;
+    }
+
+    const Value &value_at(size_type idx) const {
+        if constexpr (incremental) {
+            if (idx >= m_capacity) {
+                return m_old->m_slots[idx - m_capacity].value;
+            }
+        }
+        return m_slots[idx].value;
+    }
+
+    // makes room for count elements without exceeding the maximum load factor
+    void rehash(size_type count) {
+        const size_type required = capacity_for(count);
+        if (required > m_capacity) {
+            rehash_impl(required);
+        }
+    }
+
+    // the same moving the elements with the tasks of executor, see is_executor
+    template<class Executor>
+    void rehash(size_type count, Executor &executor) {
+        const size_type required = capacity_for(count);
+        if (required > m_capacity) {
+            rehash_parallel(required, executor);
+        }
+    }
+
+    // Inserts the elements of [first, last) whose keys are absent, in order, as a sequence of
+    // insert_by_hint(npos, ...) would, but with the tasks of executor: the slot array is split
+    // into regions by home slot and every region is filled by a single task. Elements whose
+    // probe sequence leaves their region are inserted one by one afterwards. key_of gives the
+    // key of an element, the value is constructed from the element itself. Robin hood tables
+    // and small ranges are always filled one by one. If constructing a value throws, the
+    // elements inserted by the parallel phase are removed again.
+    template<class RandomIt, class KeyFn, class Executor>
+    void insert_parallel(RandomIt first, RandomIt last, KeyFn key_of, Executor &executor) {
+        const auto n = static_cast<size_type>(last - first);
+        if (robin_hood || n < parallel_threshold) {
+            for (size_type i = 0; i < n; ++i) {
+                emplace_by_hint(npos, key_of(first[i]), first[i]);
+            }
+            return;
+        }
+        if constexpr (incremental) {
+            while (m_old != nullptr) {
+                migrate_last();
+            }
+        }
+        // no tombstones and room for every element: the regions only see empty slots and the
+        // serial phase never moves an element
+        const size_type required = std::max(capacity_for(m_size + n), m_capacity);
+        if (m_deleted > 0 || required > m_capacity) {
+            rehash_parallel(required, executor);
+        }
+        const size_type chunks = chunk_count(n);
+        std::vector<size_type> hashes(n);
+        executor(chunks, [&](size_type c) {
+            for (size_type i = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); i < end; ++i) {
+                hashes[i] = m_hash(key_of(first[i]));
+            }
+        });
+        std::vector<size_type> where(n, npos);
+        try {
+            place_parallel(n, hashes.data(), where.data(), executor,
+                           [&](size_type i) -> decltype(auto) { return key_of(first[i]); },
+                           [&](size_type i, Value *to) { new(to) Value(first[i]); });
+        } catch (...) {
+            for (size_type i = 0; i < n; ++i) {
+                if (where[i] < deferred) {
+                    m_slots[where[i]].value.~Value();
+                    set_ctrl(where[i], CTRL_DELETED);
+                    ++m_deleted;
+                }
+            }
+            throw;
+        }
+        if constexpr (linked) {
+            link_placed(n, where.data(), executor);
+        }
+        // a deferred element goes right before the next placed one, which keeps the input order
+        std::vector<std::pair<size_type, size_type>> rest;
+        for (size_type i = n, next = npos; i-- > 0;) {
+            if (where[i] == deferred) {
+                rest.emplace_back(i, next);
+            } else if (where[i] != npos) {
+                next = where[i];
+            }
+        }
+        for (auto it = rest.rbegin(); it != rest.rend(); ++it) {
+            emplace_with_hash(it->second, key_of(first[it->first]), hashes[it->first], first[it->first]);
+        }
+    }
+
+    float max_load_factor() const {
+        return m_max_load;
+    }
+
+    // the table always keeps an empty slot, so the factor is clamped to [1/16, 15/16]
+    void max_load_factor(float ml) {
+        m_max_load = std::min(std::max(ml, 0.0625f), 0.9375f);
+        rehash(m_size + m_deleted);
+    }
+
+    size_type tombstones() const {
+        return m_deleted;
+    }
+
+    // whether an incremental resize has elements left in the old arrays
+    bool migrating() const {
+        if constexpr (incremental) {
+            return m_old != nullptr;
+        } else {
+            return false;
+        }
+    }
+
+    template<class F>
+    void for_each_tombstone(F f) const {
+        for (size_type i = 0; i < m_capacity; ++i) {
+            if (m_ctrl[i] == CTRL_DELETED) {
+                f(i);
+            }
+        }
+    }
+
+    // Restoring a saved layout: the table is emptied and given exactly the saved capacity, then
+    // restore_tombstone and restore_at put tombstones and elements straight into their saved
+    // slots, the elements in iteration order, without probing. The layout is valid only if it
+    // was saved with the same hasher and policies; rebuild() re-places everything otherwise.
+    // Returns false if the capacity cannot be reproduced.
+    bool restore_layout(size_type capacity) {
+        clear();
+        if (m_capacity != capacity) {
+            rehash_impl(capacity);
+        }
+        return m_capacity == capacity;
+    }
+
+    bool restore_tombstone(size_type idx) {
+        if (idx >= m_capacity || m_ctrl[idx] != CTRL_EMPTY) {
+            return false;
+        }
+        set_ctrl(idx, CTRL_DELETED);
+        ++m_deleted;
+        return true;
+    }
+
+    // returns false without constructing anything if the slot is not free
+    template<class... Args>
+    bool restore_at(size_type idx, size_type hash, Args &&... args) {
+        if (idx >= m_capacity || m_ctrl[idx] != CTRL_EMPTY) {
+            return false;
+        }
+        new(&m_slots[idx].value) Value(std::forward<Args>(args)...);
+        if constexpr (robin_hood) {
+            m_dist[idx] = static_cast<distance_type>((idx + m_capacity - Reducer::index(hash, m_capacity)) % m_capacity);
+        }
+        if constexpr (store_hash) {
+            m_hashes[idx] = hash;
+        }
+        set_ctrl(idx, hash_tag(hash));
+        link_before(idx, npos);
+        ++m_size;
+        return true;
+    }
+
+    // re-places every element by its hash keeping the capacity, tombstones are dropped
+    void rebuild() {
+        if (m_capacity > 0) {
+            rehash_impl(m_capacity);
+        }
+    }
+
+#ifdef OAH_STATS
+    // the counters since construction or the last reset_stats, the clusters of the current arrays
+    TableStats stats() const {
+        TableStats res;
+        m_stats.fill(res);
+        res.size = m_size;
+        res.capacity = m_capacity;
+        res.tombstones = m_deleted;
+        // runs are taken from an empty slot, so that a run wrapping around the end counts once
+        size_type start = 0;
+        while (start < m_capacity && m_ctrl[start] != CTRL_EMPTY) {
+            ++start;
+        }
+        size_type run = 0;
+        for (size_type k = 1; k <= m_capacity && start < m_capacity; ++k) {
+            const size_type idx = (start + k) % m_capacity;
+            if (m_ctrl[idx] != CTRL_EMPTY) {
+                ++run;
+            } else if (run > 0) {
+                size_type bucket = 0;
+                while (bucket + 1 < TableStats::histogram_size && (run >> (bucket + 1)) != 0) {
+                    ++bucket;
+                }
+                ++res.clusters[bucket];
+                run = 0;
+            }
+        }
+        return res;
+    }
+
+    void reset_stats() {
+        m_stats.reset();
+    }
+#endif
+
+private:
+    using group_type = typename CollisionPolicy::group_type;
+
+    static constexpr size_type group_width = group_type::width;
+
+    static constexpr bool robin_hood = is_robin_hood<CollisionPolicy>::value;
+
+    static constexpr bool store_hash = is_hash_stored<Hash>::value;
+
+    static constexpr bool incremental = is_incremental<GrowthPolicy>::value;
+
+    static constexpr size_type lookup_batch = 16;
+
+    // parallel operations: fewer elements are handled one by one, regions of the slot array
+    // are never smaller than min_region slots and the work is cut into at most max_tasks parts
+    static constexpr size_type parallel_threshold = 16384;
+    static constexpr size_type min_region = 4096;
+    static constexpr size_type max_tasks = 256;
+
+    // where an element of a parallel operation has gone when it is neither placed nor a duplicate
+    static constexpr size_type deferred = npos - 1;
+
+    // probe lengths of robin hood tables are kept below this hard limit even when max_distance
+    // cannot be honoured because the hasher maps too many keys to the same slot
+    using distance_type = std::uint16_t;
+
+    struct LinkedSlot {
+        size_type prev = npos, next = npos;
+        union {
+            Value value;
+        };
+
+        LinkedSlot() {}
+
+        LinkedSlot(const LinkedSlot &) = delete;
+
+        ~LinkedSlot() {}
+    };
+
+    struct PlainSlot {
+        union {
+            Value value;
+        };
+
+        PlainSlot() {}
+
+        PlainSlot(const PlainSlot &) = delete;
+
+        ~PlainSlot() {}
+    };
+
+    using alloc_traits = std::allocator_traits<Allocator>;
+
+    Slot *m_slots = nullptr;
+    // capacity + group_width - 1 bytes, the tail mirrors the head so that a group can be
+    // loaded at any position without wrapping
+    ctrl_t *m_ctrl = nullptr;
+    // distance of every element from its home slot, robin hood tables only
+    distance_type *m_dist = nullptr;
+    // full hash of every element when the hasher asks to store them
+    size_type *m_hashes = nullptr;
+    // the elements not moved yet by an incremental resize, placed before the current ones in
+    // the iteration order
+    HashTable *m_old = nullptr;
+    // the arrays for the next incremental resize, of which m_spare_ready slots are initialized
+    HashTable *m_spare = nullptr;
+    size_type m_spare_ready = 0;
+    size_type m_capacity = 0;
+    size_type m_size = 0;
+    size_type m_deleted = 0;
+    size_type m_begin = npos;
+    size_type m_last = npos;
+    // an element whose moves are followed during a single operation: the insertion hint
+    // or the element after an erased one
+    size_type m_tracked = npos;
+    float m_max_load = default_max_load_factor;
+#ifdef OAH_STATS
+    mutable StatsCounters m_stats;
+#endif
+    Hash m_hash;
+    Equal m_equal;
+    Allocator m_alloc;
+
+    // statistics hooks, empty unless OAH_STATS is defined
+    void note_lookup([[maybe_unused]] bool hit, [[maybe_unused]] size_type steps) const {
+#ifdef OAH_STATS
+        m_stats.lookup(hit, steps);
+#endif
+    }
+
+    // a probe of an insert finding the key is counted as a hit
+    void note_insert_probe([[maybe_unused]] bool found, [[maybe_unused]] size_type steps) const {
+#ifdef OAH_STATS
+        if (found) {
+            m_stats.lookup(true, steps);
+        } else {
+            m_stats.insert(steps);
+        }
+#endif
+    }
+
+    static auto stats_now() {
+#ifdef OAH_STATS
+        return std::chrono::steady_clock::now();
+#else
+        return 0;
+#endif
+    }
+
+    template<class TimePoint>
+    void note_rehash([[maybe_unused]] TimePoint started) const {
+#ifdef OAH_STATS
+        m_stats.rehash(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started));
+#endif
+    }
+
+    // probe steps of a robin hood probe ending at idx
+    size_type robin_hood_steps(size_type idx, size_type hash) const {
+        if (idx == npos) {
+            return m_capacity;
+        }
+        return (idx + m_capacity - Reducer::index(hash, m_capacity)) % m_capacity + 1;
+    }
+
+    size_type capacity_for(size_type count) const {
+        return static_cast<size_type>(std::ceil(static_cast<float>(count) / m_max_load));
+    }
+
+    // the capacity after the next step of the growth policy, enough for one more element
+    void grow() {
+        const size_type capacity = std::max(GrowthPolicy::next(m_capacity), capacity_for(m_size + 1));
+        if constexpr (incremental) {
+            while (m_old != nullptr) {
+                migrate_last();
+            }
+            start_migration(capacity);
+            // the insertion hint must not stay behind in the old arrays
+            while (m_tracked != npos && m_tracked >= m_capacity) {
+                migrate_last();
+            }
+        } else {
+            rehash_impl(capacity);
+        }
+    }
+
+    size_type first_index() const {
+        if constexpr (incremental) {
+            if (m_old != nullptr) {
+                return m_old->m_begin + m_capacity;
+            }
+        }
+        if constexpr (linked) {
+            return m_begin;
+        } else {
+            return next_full(0);
+        }
+    }
+
+    // the first full slot at or after idx, a group of control bytes at a time
+    size_type next_full(size_type idx) const {
+        for (; idx + SimdGroup::width <= m_capacity; idx += SimdGroup::width) {
+            if (auto full = SimdGroup(m_ctrl + idx).match_full()) {
+                return idx + full.lowest();
+            }
+        }
+        for (; idx < m_capacity; ++idx) {
+            if (is_full(m_ctrl[idx])) {
+                return idx;
+            }
+        }
+        return npos;
+    }
+
+    // the index following an element of the old arrays given its next link there
+    size_type old_next(size_type next) const {
+        return next == npos ? m_begin : next + m_capacity;
+    }
+
+    // Moves the elements into fresh arrays of new_capacity slots lazily: the current arrays
+    // become the old ones, the elements are moved by the following operations.
+    void start_migration(size_type new_capacity) {
+        note_rehash(stats_now());
+        new_capacity = GrowthPolicy::fit(std::max<size_type>(new_capacity, std::max<size_type>(group_width, 2)));
+        if (m_spare != nullptr && m_spare->m_capacity < new_capacity) {
+            drop_spare();
+        }
+        HashTable *old = m_spare;
+        if (old != nullptr) {
+            // normally ready by now, unless the table filled up faster than its load factor predicts
+            old->init_arrays(m_spare_ready, old->m_capacity);
+            m_spare = nullptr;
+            old->steal(*this);
+        } else {
+            old = allocate_array<HashTable>(1);
+            new(old) HashTable(0, m_hash, m_equal, m_alloc);
+            old->steal(*this);
+            try {
+                allocate_arrays(new_capacity);
+            } catch (...) {
+                steal(*old);
+                old->~HashTable();
+                deallocate_array(old, 1);
+                throw;
+            }
+        }
+        m_size = old->m_size;
+        m_max_load = old->m_max_load;
+        m_old = old;
+        if (m_tracked != npos) {
+            m_tracked += m_capacity;
+        }
+    }
+
+    // Moves up to migration_step elements out of the old arrays, then keeps going as long as
+    // tracked, whose index is returned updated, is one of them.
+    size_type migrate(size_type tracked) {
+        m_tracked = tracked;
+        for (size_type n = 0; m_old != nullptr && (n < GrowthPolicy::migration_step ||
+                                                   (m_tracked != npos && m_tracked >= m_capacity)); ++n) {
+            migrate_last();
+        }
+        tracked = m_tracked;
+        m_tracked = npos;
+        return tracked;
+    }
+
+    // the last element of the old arrays becomes the first of the current ones, which keeps
+    // the iteration order
+    void migrate_last() {
+        const size_type from = m_old->m_last;
+        Value &value = m_old->m_slots[from].value;
+        const size_type hash = m_old->slot_hash(from);
+        const size_type to = find_free(hash);
+        new(&m_slots[to].value) Value(std::move(value));
+        if (m_ctrl[to] == CTRL_DELETED) {
+            --m_deleted;
+        }
+        if constexpr (store_hash) {
+            m_hashes[to] = hash;
+        }
+        set_ctrl(to, hash_tag(hash));
+        link_before(to, m_begin);
+        if (m_tracked == from + m_capacity) {
+            m_tracked = to;
+        }
+        evict_old(from);
+    }
+
+    // Destroys the element at idx of the old arrays leaving a tombstone, so that no other
+    // element moves, and frees the arrays once empty. Returns the index following it.
+    size_type evict_old(size_type idx) {
+        HashTable &old = *m_old;
+        const size_type next = old.m_slots[idx].next;
+        old.unlink(idx);
+        old.m_slots[idx].value.~Value();
+        old.set_ctrl(idx, CTRL_DELETED);
+        ++old.m_deleted;
+        if (--old.m_size == 0) {
+            drop_old();
+        }
+        return old_next(next);
+    }
+
+    void drop_old() {
+        if (m_old != nullptr) {
+            discard(m_old);
+            m_old = nullptr;
+        }
+    }
+
+    // Allocates the arrays of the next incremental resize once the table is half way to it and
+    // initializes a part of them on every insert, in proportion to the inserts left before it,
+    // so that they are ready by then without a pause.
+    void prepare_spare() {
+        const size_type used = m_size + m_deleted + 1;
+        const auto limit = static_cast<size_type>(m_max_load * static_cast<float>(m_capacity));
+        if (2 * used < limit) {
+            return;
+        }
+        if (m_spare == nullptr) {
+            const size_type capacity = std::max(GrowthPolicy::next(m_capacity), capacity_for(m_size + 1));
+            HashTable *spare = allocate_array<HashTable>(1);
+            new(spare) HashTable(0, m_hash, m_equal, m_alloc);
+            try {
+                spare->allocate_raw_arrays(GrowthPolicy::fit(std::max<size_type>(capacity, std::max<size_type>(group_width, 2))));
+            } catch (...) {
+                spare->~HashTable();
+                deallocate_array(spare, 1);
+                throw;
+            }
+            m_spare = spare;
+            m_spare_ready = 0;
+        }
+        const size_type left = m_spare->m_capacity - m_spare_ready;
+        const size_type inserts_left = limit > used ? limit - used + 1 : 1;
+        const size_type ready = m_spare_ready + (left + inserts_left - 1) / inserts_left;
+        m_spare->init_arrays(m_spare_ready, ready);
+        m_spare_ready = ready;
+    }
+
+    void drop_spare() {
+        if (m_spare != nullptr) {
+            discard(m_spare);
+            m_spare = nullptr;
+        }
+    }
+
+    // destroys a table used by an incremental resize without resetting its control bytes first
+    void discard(HashTable *table) {
+        if (table->m_size > 0) {
+            table->clear();
+        }
+        table->deallocate_arrays(table->m_slots, table->m_ctrl, table->m_dist, table->m_hashes, table->m_capacity);
+        table->m_slots = nullptr;
+        table->m_ctrl = nullptr;
+        table->m_dist = nullptr;
+        table->m_hashes = nullptr;
+        table->m_capacity = 0;
+        table->~HashTable();
+        deallocate_array(table, 1);
+    }
+
+    size_type slot_index(size_type pos) const {
+        return pos < m_capacity ? pos : pos - m_capacity;
+    }
+
+    void set_ctrl(size_type idx, ctrl_t c) {
+        m_ctrl[idx] = c;
+        if (idx < group_width - 1) {
+            m_ctrl[idx + m_capacity] = c;
+        }
+    }
+
+    // the lookup in the current arrays only
+    template<class K>
+    size_type probe_for_key(const K &key, size_type hash) const {
+        if constexpr (robin_hood) {
+            auto found = robin_hood_probe(key, hash);
+            note_lookup(found.second, robin_hood_steps(found.first, hash));
+            return found.second ? found.first : npos;
+        }
+        const size_type capacity = m_capacity;
+        const ctrl_t tag = hash_tag(hash);
+        size_type pos = Reducer::index(hash, capacity);
+        size_type step_num = 1;
+        for (; step_num <= capacity; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+            group_type group(&m_ctrl[pos]);
+            for (unsigned i : group.match(tag)) {
+                size_type idx = slot_index(pos + i);
+                if (same_key(idx, key, hash)) {
+                    note_lookup(true, step_num);
+                    return idx;
+                }
+            }
+            if (group.match_empty()) {
+                break;
+            }
+        }
+        note_lookup(false, step_num);
+        return npos;
+    }
+
+    // (index of the key, true) if it is present, otherwise (slot to insert into, false)
+    // where the slot is npos if the probe sequence has no free slot
+    template<class K>
+    std::pair<size_type, bool> probe_for_insert(const K &key, size_type hash) const {
+        if constexpr (robin_hood) {
+            auto found = robin_hood_probe(key, hash);
+            note_insert_probe(found.second, robin_hood_steps(found.first, hash));
+            return found;
+        }
+        const size_type capacity = m_capacity;
+        const ctrl_t tag = hash_tag(hash);
+        size_type pos = Reducer::index(hash, capacity);
+        size_type free_idx = npos;
+        size_type free_step = capacity;
+        for (size_type step_num = 1; step_num <= capacity; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+            group_type group(&m_ctrl[pos]);
+            for (unsigned i : group.match(tag)) {
+                size_type idx = slot_index(pos + i);
+                if (same_key(idx, key, hash)) {
+                    note_insert_probe(true, step_num);
+                    return std::make_pair(idx, true);
+                }
+            }
+            if (free_idx == npos) {
+                auto free = group.match_free();
+                if (free) {
+                    free_idx = slot_index(pos + free.lowest());
+                    free_step = step_num;
+                }
+            }
+            if (group.match_empty()) {
+                break;
+            }
+        }
+        note_insert_probe(false, free_step);
+        return std::make_pair(free_idx, false);
+    }
+
+    // Picks the slot for an absent key given the free slot its probe found, growing the table
+    // when needed. The slot stays free until the caller fills it.
+    size_type prepare_slot(size_type hash, size_type free_idx) {
+        if constexpr (incremental) {
+            prepare_spare();
+        }
+        const bool reuses_tombstone = free_idx != npos && m_ctrl[free_idx] == CTRL_DELETED;
+        if (free_idx == npos ||
+            (!reuses_tombstone && static_cast<float>(m_size + m_deleted + 1) > m_max_load * static_cast<float>(m_capacity))) {
+            // purging tombstones in place is enough when they take at least half of the used slots
+            if (m_deleted > 0 && m_deleted >= m_size) {
+                drop_tombstones();
+            } else {
+                grow();
+            }
+            free_idx = robin_hood ? npos : find_free(hash);
+        }
+        if constexpr (robin_hood) {
+            free_idx = robin_hood_place(hash, true);
+            while (free_idx == npos) {
+                rehash_impl(GrowthPolicy::next(m_capacity));
+                free_idx = robin_hood_place(hash, true);
+            }
+        }
+        return free_idx;
+    }
+
+    // a miss ends at the first slot whose element is closer to its home than the probe
+    template<class K>
+    std::pair<size_type, bool> robin_hood_probe(const K &key, size_type hash) const {
+        const size_type capacity = m_capacity;
+        const ctrl_t tag = hash_tag(hash);
+        size_type idx = Reducer::index(hash, capacity);
+        for (size_type dist = 0; dist < capacity; ++dist, idx = CollisionPolicy::next(idx, 1, capacity)) {
+            if (m_ctrl[idx] == CTRL_EMPTY || m_dist[idx] < dist) {
+                return std::make_pair(idx, false);
+            }
+            if (m_ctrl[idx] == tag && same_key(idx, key, hash)) {
+                return std::make_pair(idx, true);
+            }
+        }
+        return std::make_pair(npos, false);
+    }
+
+    // Frees the slot where an absent key with the given hash belongs by moving the rest of
+    // its cluster one slot forward. Returns npos instead when bounded and some probe length
+    // would exceed the policy's max_distance while the table is not nearly empty.
+    size_type robin_hood_place(size_type hash, bool bounded) {
+        const size_type capacity = m_capacity;
+        const size_type limit = bounded && static_cast<float>(m_size) / static_cast<float>(capacity) >= 0.125f
+                                ? CollisionPolicy::max_distance
+                                : std::numeric_limits<distance_type>::max();
+        size_type pos = Reducer::index(hash, capacity);
+        size_type dist = 0;
+        for (; m_ctrl[pos] != CTRL_EMPTY && m_dist[pos] >= dist; pos = CollisionPolicy::next(pos, 1, capacity)) {
+            if (++dist > limit) {
+                return exceeded(bounded);
+            }
+        }
+        size_type last = pos;
+        while (m_ctrl[last] != CTRL_EMPTY) {
+            if (m_dist[last] + 1u > limit) {
+                return exceeded(bounded);
+            }
+            last = CollisionPolicy::next(last, 1, capacity);
+        }
+        while (last != pos) {
+            size_type prev = last == 0 ? capacity - 1 : last - 1;
+            relocate(prev, last);
+            m_dist[last] = static_cast<distance_type>(m_dist[prev] + 1);
+            last = prev;
+        }
+        m_dist[pos] = static_cast<distance_type>(dist);
+        return pos;
+    }
+
+    static size_type exceeded(bool bounded) {
+        if (!bounded) {
+            throw std::length_error("HashTable: probe length limit exceeded");
+        }
+        return npos;
+    }
+
+    // first free slot on the probe sequence of a key which is known to be absent;
+    // group_pos receives the position of the group it was found in
+    size_type find_free(size_type hash, size_type *group_pos = nullptr) {
+        if constexpr (robin_hood) {
+            return robin_hood_place(hash, false);
+        }
+        const size_type capacity = m_capacity;
+        size_type pos = Reducer::index(hash, capacity);
+        for (size_type step_num = 1;; ++step_num) {
+            auto free = group_type(&m_ctrl[pos]).match_free();
+            if (free) {
+                if (group_pos != nullptr) {
+                    *group_pos = pos;
+                }
+                return slot_index(pos + free.lowest());
+            }
+            // a policy whose sequence does not cover the table falls back to a linear scan
+            pos = step_num < capacity ? CollisionPolicy::next(pos, step_num, capacity) : LinearProbing::next(pos, 0, capacity);
+        }
+    }
+
+    static size_type chunk_count(size_type n) {
+        return std::min(max_tasks, std::max<size_type>(n / min_region, 1));
+    }
+
+    static size_type chunk_begin(size_type c, size_type chunks, size_type n) {
+        return c == chunks ? n : n / chunks * c + std::min(c, n % chunks);
+    }
+
+    // regions split the current arrays, region r starting at the first slot whose home_index
+    // times regions over the capacity is r
+    size_type region_count() const {
+        return std::min(max_tasks, std::max<size_type>(m_capacity / min_region, 1));
+    }
+
+    size_type region_of(size_type hash, size_type regions) const {
+        return Reducer::index(hash, m_capacity) * regions / m_capacity;
+    }
+
+    size_type region_begin(size_type r, size_type regions) const {
+        return (r * m_capacity + regions - 1) / regions;
+    }
+
+    // Puts n items given by their hashes into the current arrays, which must have room for
+    // them and no tombstones, with one task per region. where[i] receives the slot of item i,
+    // npos if its key is already present (in the table or earlier in the items) or deferred
+    // if its probe sequence leaves the region; the caller links the placed ones and adds m_size.
+    template<class Executor, class KeyAt, class Construct>
+    void place_parallel(size_type n, const size_type *hashes, size_type *where, Executor &executor,
+                        KeyAt key_at, Construct construct) {
+        const size_type regions = region_count();
+        const size_type chunks = chunk_count(n);
+        // the items are sorted by region keeping their order: counted per chunk, then scattered
+        std::vector<size_type> offsets(chunks * regions);
+        executor(chunks, [&](size_type c) {
+            for (size_type i = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); i < end; ++i) {
+                ++offsets[c * regions + region_of(hashes[i], regions)];
+            }
+        });
+        std::vector<size_type> bounds(regions + 1);
+        size_type total = 0;
+        for (size_type r = 0; r < regions; ++r) {
+            bounds[r] = total;
+            for (size_type c = 0; c < chunks; ++c) {
+                const size_type count = offsets[c * regions + r];
+                offsets[c * regions + r] = total;
+                total += count;
+            }
+        }
+        bounds[regions] = total;
+        std::vector<size_type> order(n);
+        executor(chunks, [&](size_type c) {
+            for (size_type i = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); i < end; ++i) {
+                order[offsets[c * regions + region_of(hashes[i], regions)]++] = i;
+            }
+        });
+        std::vector<size_type> placed(regions);
+        executor(regions, [&](size_type r) {
+            const size_type lo = region_begin(r, regions);
+            const size_type hi = region_begin(r + 1, regions);
+            for (size_type k = bounds[r]; k < bounds[r + 1]; ++k) {
+                const size_type i = order[k];
+                where[i] = place_in_region(hashes[i], key_at(i), lo, hi, [&](Value *to) {
+                    construct(i, to);
+                });
+                if (where[i] < deferred) {
+                    ++placed[r];
+                }
+            }
+        });
+        for (size_type r = 0; r < regions; ++r) {
+            m_size += placed[r];
+        }
+    }
+
+    // links the items placed by place_parallel chunk by chunk in their input order and appends them
+    template<class Executor>
+    void link_placed(size_type n, const size_type *where, Executor &executor) {
+        const size_type chunks = chunk_count(n);
+        std::vector<size_type> chunk_first(chunks, npos), chunk_last(chunks, npos);
+        executor(chunks, [&](size_type c) {
+            size_type prev = npos;
+            for (size_type i = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); i < end; ++i) {
+                const size_type idx = where[i];
+                if (idx >= deferred) {
+                    continue;
+                }
+                m_slots[idx].prev = prev;
+                if (prev != npos) {
+                    m_slots[prev].next = idx;
+                } else {
+                    chunk_first[c] = idx;
+                }
+                prev = idx;
+            }
+            if (prev != npos) {
+                m_slots[prev].next = npos;
+            }
+            chunk_last[c] = prev;
+        });
+        for (size_type c = 0; c < chunks; ++c) {
+            if (chunk_first[c] != npos) {
+                m_slots[chunk_first[c]].prev = m_last;
+                if (m_last != npos) {
+                    m_slots[m_last].next = chunk_first[c];
+                } else {
+                    m_begin = chunk_first[c];
+                }
+                m_last = chunk_last[c];
+            }
+        }
+    }
+
+    // probes like probe_for_insert and find_free together, giving up as soon as a group to load
+    // is not entirely inside [lo, hi)
+    template<class K, class Construct>
+    size_type place_in_region(size_type hash, const K &key, size_type lo, size_type hi, Construct construct) {
+        const size_type capacity = m_capacity;
+        const ctrl_t tag = hash_tag(hash);
+        size_type pos = Reducer::index(hash, capacity);
+        for (size_type step_num = 1; step_num <= capacity; pos = CollisionPolicy::next(pos, step_num++, capacity)) {
+            if (pos < lo || pos + group_width > hi) {
+                return deferred;
+            }
+            size_type free_idx = npos;
+            for (size_type idx = pos; idx < pos + group_width; ++idx) {
+                if (m_ctrl[idx] == tag && same_key(idx, key, hash)) {
+                    return npos;
+                }
+                if (free_idx == npos && m_ctrl[idx] == CTRL_EMPTY) {
+                    free_idx = idx;
+                }
+            }
+            if (free_idx != npos) {
+                construct(&m_slots[free_idx].value);
+                if constexpr (store_hash) {
+                    m_hashes[free_idx] = hash;
+                }
+                set_ctrl(free_idx, tag);
+                return free_idx;
+            }
+        }
+        return deferred;
+    }
+
+    // rehash_impl with the elements moved by the tasks of executor
+    template<class Executor>
+    void rehash_parallel(size_type new_capacity, Executor &executor) {
+        const auto started = stats_now();
+        if constexpr (incremental) {
+            while (m_old != nullptr) {
+                migrate_last();
+            }
+            drop_spare();
+        }
+        if (robin_hood || m_size < parallel_threshold) {
+            rehash_impl(new_capacity);
+            return;
+        }
+        new_capacity = GrowthPolicy::fit(std::max<size_type>(new_capacity, std::max<size_type>(group_width, 2)));
+        Slot *old = m_slots;
+        ctrl_t *old_ctrl = m_ctrl;
+        distance_type *old_dist = m_dist;
+        size_type *old_hashes = m_hashes;
+        const size_type old_capacity = m_capacity;
+        const size_type old_begin = m_begin, old_last = m_last;
+        const size_type n = m_size;
+        // the full slots of the old arrays, in slot order
+        const size_type scan_chunks = chunk_count(old_capacity);
+        std::vector<size_type> found(scan_chunks + 1);
+        executor(scan_chunks, [&](size_type c) {
+            for (size_type i = chunk_begin(c, scan_chunks, old_capacity), end = chunk_begin(c + 1, scan_chunks, old_capacity); i < end; ++i) {
+                found[c + 1] += is_full(old_ctrl[i]) ? 1 : 0;
+            }
+        });
+        for (size_type c = 0; c < scan_chunks; ++c) {
+            found[c + 1] += found[c];
+        }
+        std::vector<size_type> items(n), hashes(n);
+        executor(scan_chunks, [&](size_type c) {
+            size_type k = found[c];
+            for (size_type i = chunk_begin(c, scan_chunks, old_capacity), end = chunk_begin(c + 1, scan_chunks, old_capacity); i < end; ++i) {
+                if (is_full(old_ctrl[i])) {
+                    items[k] = i;
+                    if constexpr (store_hash) {
+                        hashes[k] = old_hashes[i];
+                    } else {
+                        hashes[k] = m_hash(KeyOf::get(old[i].value));
+                    }
+                    ++k;
+                }
+            }
+        });
+        std::vector<size_type> where(n, npos);
+        std::vector<size_type> moved_to(linked ? old_capacity : 0);
+        allocate_raw_arrays(new_capacity);
+        const size_type init_chunks = chunk_count(new_capacity);
+        executor(init_chunks, [&](size_type c) {
+            init_arrays(chunk_begin(c, init_chunks, new_capacity), chunk_begin(c + 1, init_chunks, new_capacity));
+        });
+        m_size = 0;
+        m_deleted = 0;
+        auto move_item = [&](size_type k, Value *to) {
+            Value &from = old[items[k]].value;
+            new(to) Value(std::move(from));
+            from.~Value();
+        };
+        place_parallel(n, hashes.data(), where.data(), executor,
+                       [&](size_type k) -> const Key & { return KeyOf::get(old[items[k]].value); },
+                       move_item);
+        for (size_type k = 0; k < n; ++k) {
+            if (where[k] == deferred) {
+                where[k] = find_free(hashes[k]);
+                move_item(k, &m_slots[where[k]].value);
+                if constexpr (store_hash) {
+                    m_hashes[where[k]] = hashes[k];
+                }
+                set_ctrl(where[k], hash_tag(hashes[k]));
+                ++m_size;
+            }
+        }
+        if constexpr (linked) {
+            // the links of the old slots are translated to the new ones
+            const size_type chunks = chunk_count(n);
+            executor(chunks, [&](size_type c) {
+                for (size_type k = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); k < end; ++k) {
+                    moved_to[items[k]] = where[k];
+                }
+            });
+            auto translate = [&](size_type idx) {
+                return idx == npos ? npos : moved_to[idx];
+            };
+            executor(chunks, [&](size_type c) {
+                for (size_type k = chunk_begin(c, chunks, n), end = chunk_begin(c + 1, chunks, n); k < end; ++k) {
+                    m_slots[where[k]].prev = translate(old[items[k]].prev);
+                    m_slots[where[k]].next = translate(old[items[k]].next);
+                }
+            });
+            m_begin = translate(old_begin);
+            m_last = translate(old_last);
+        }
+        deallocate_arrays(old, old_ctrl, old_dist, old_hashes, old_capacity);
+        note_rehash(started);
+    }
+
+    // moves every element into fresh arrays of new_capacity slots keeping the iteration order
+    void rehash_impl(size_type new_capacity) {
+        const auto started = stats_now();
+        if constexpr (incremental) {
+            while (m_old != nullptr) {
+                migrate_last();
+            }
+            drop_spare();
+        }
+        new_capacity = GrowthPolicy::fit(std::max<size_type>(new_capacity, std::max<size_type>(group_width, 2)));
+        Slot *old = m_slots;
+        ctrl_t *old_ctrl = m_ctrl;
+        distance_type *old_dist = m_dist;
+        size_type *old_hashes = m_hashes;
+        const size_type old_capacity = m_capacity;
+        allocate_arrays(new_capacity);
+        m_deleted = 0;
+        // linked tables keep the order of the links, the others go through the old slots in order
+        auto old_next_full = [old_ctrl, old_capacity](size_type idx) {
+            while (idx < old_capacity && !is_full(old_ctrl[idx])) {
+                ++idx;
+            }
+            return idx < old_capacity ? idx : npos;
+        };
+        size_type i = linked ? m_begin : old_next_full(0);
+        const size_type tracked = m_tracked;
+        m_tracked = npos;
+        m_begin = m_last = npos;
+        while (i != npos) {
+            Slot &from = old[i];
+            size_type hash;
+            if constexpr (store_hash) {
+                hash = old_hashes[i];
+            } else {
+                hash = m_hash(KeyOf::get(from.value));
+            }
+            size_type to = find_free(hash);
+            new(&m_slots[to].value) Value(std::move(from.value));
+            if constexpr (store_hash) {
+                m_hashes[to] = hash;
+            }
+            set_ctrl(to, hash_tag(hash));
+            link_before(to, npos);
+            from.value.~Value();
+            if (i == tracked) {
+                m_tracked = to;
+            }
+            if constexpr (linked) {
+                i = from.next;
+            } else {
+                i = old_next_full(i + 1);
+            }
+        }
+        deallocate_arrays(old, old_ctrl, old_dist, old_hashes, old_capacity);
+        note_rehash(started);
+    }
+
+    template<class T>
+    T *allocate_array(size_type n) {
+        typename alloc_traits::template rebind_alloc<T> alloc(m_alloc);
+        return std::allocator_traits<decltype(alloc)>::allocate(alloc, n);
+    }
+
+    template<class T>
+    void deallocate_array(T *p, size_type n) {
+        if (p != nullptr) {
+            typename alloc_traits::template rebind_alloc<T> alloc(m_alloc);
+            std::allocator_traits<decltype(alloc)>::deallocate(alloc, p, n);
+        }
+    }
+
+    // replaces the array pointers with empty arrays of the given capacity, the old ones are left to the caller
+    void allocate_arrays(size_type capacity) {
+        allocate_raw_arrays(capacity);
+        init_arrays(0, capacity);
+    }
+
+    // the same leaving the slots to be initialized by init_arrays
+    void allocate_raw_arrays(size_type capacity) {
+        Slot *slots = allocate_array<Slot>(capacity);
+        ctrl_t *ctrl = nullptr;
+        distance_type *dist = nullptr;
+        size_type *hashes = nullptr;
+        try {
+            ctrl = allocate_array<ctrl_t>(capacity + group_width - 1);
+            if (robin_hood) {
+                dist = allocate_array<distance_type>(capacity);
+            }
+            if (store_hash) {
+                hashes = allocate_array<size_type>(capacity);
+            }
+        } catch (...) {
+            deallocate_arrays(slots, ctrl, dist, hashes, capacity);
+            throw;
+        }
+        m_slots = slots;
+        m_ctrl = ctrl;
+        m_dist = dist;
+        m_hashes = hashes;
+        m_capacity = capacity;
+    }
+
+    // makes the slots in [from, to) of freshly allocated arrays empty
+    void init_arrays(size_type from, size_type to) {
+        to = std::min(to, m_capacity);
+        for (size_type i = from; i < to; ++i) {
+            new(m_slots + i) Slot();
+        }
+        std::fill(m_ctrl + from, m_ctrl + to, CTRL_EMPTY);
+        if (from < to && to == m_capacity) {
+            std::fill_n(m_ctrl + m_capacity, group_width - 1, CTRL_EMPTY);
+        }
+        if (robin_hood) {
+            std::fill(m_dist + from, m_dist + to, 0);
+        }
+    }
+
+    // the elements must be destroyed already
+    void deallocate_arrays(Slot *slots, ctrl_t *ctrl, distance_type *dist, size_type *hashes, size_type capacity) {
+        deallocate_array(slots, capacity);
+        deallocate_array(ctrl, capacity + group_width - 1);
+        deallocate_array(dist, capacity);
+        deallocate_array(hashes, capacity);
+    }
+
+    // destroys the elements and frees the arrays
+    void release() {
+        clear();
+        if constexpr (incremental) {
+            drop_spare();
+        }
+        deallocate_arrays(m_slots, m_ctrl, m_dist, m_hashes, m_capacity);
+        m_slots = nullptr;
+        m_ctrl = nullptr;
+        m_dist = nullptr;
+        m_hashes = nullptr;
+        m_capacity = 0;
+    }
+
+    // exchanges everything but the allocators
+    void steal(HashTable &other) noexcept {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_dist, other.m_dist);
+        std::swap(m_hashes, other.m_hashes);
+        std::swap(m_old, other.m_old);
+        std::swap(m_spare, other.m_spare);
+        std::swap(m_spare_ready, other.m_spare_ready);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+        std::swap(m_begin, other.m_begin);
+        std::swap(m_last, other.m_last);
+        std::swap(m_max_load, other.m_max_load);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+    size_type home_index(size_type idx) const {
+        return Reducer::index(slot_hash(idx), m_capacity);
+    }
+
+    void prefetch_home(size_type hash) const {
+        if (m_size == 0) {
+            return;
+        }
+        const size_type idx = Reducer::index(hash, m_capacity);
+        prefetch(&m_ctrl[idx]);
+        prefetch(&m_slots[idx]);
+        if constexpr (robin_hood) {
+            prefetch(&m_dist[idx]);
+        }
+        if constexpr (store_hash) {
+            prefetch(&m_hashes[idx]);
+        }
+    }
+
+    size_type slot_hash(size_type idx) const {
+        if constexpr (incremental) {
+            if (idx >= m_capacity) {
+                return m_old->slot_hash(idx - m_capacity);
+            }
+        }
+        if constexpr (store_hash) {
+            return m_hashes[idx];
+        } else {
+            return m_hash(KeyOf::get(m_slots[idx].value));
+        }
+    }
+
+    // with stored hashes Equal is called only on a full hash match
+    template<class K>
+    bool same_key(size_type idx, const K &key, size_type hash) const {
+        if constexpr (store_hash) {
+            if (m_hashes[idx] != hash) {
+                return false;
+            }
+        }
+        return m_equal(KeyOf::get(m_slots[idx].value), key);
+    }
+
+    // fills the hole left at idx by moving back the elements of the cluster after it which
+    // may live there; a robin hood cluster simply moves back until an element at its home
+    void shift_back(size_type hole) {
+        const size_type capacity = m_capacity;
+        for (size_type idx = CollisionPolicy::next(hole, 1, capacity);
+             m_ctrl[idx] != CTRL_EMPTY;
+             idx = CollisionPolicy::next(idx, 1, capacity)) {
+            if constexpr (robin_hood) {
+                if (m_dist[idx] == 0) {
+                    break;
+                }
+                m_dist[hole] = static_cast<distance_type>(m_dist[idx] - 1);
+            } else {
+                const size_type home = home_index(idx);
+                const size_type from_home = idx >= home ? idx - home : idx + capacity - home;
+                const size_type from_hole = idx >= hole ? idx - hole : idx + capacity - hole;
+                if (from_home < from_hole) {
+                    continue;
+                }
+            }
+            relocate(idx, hole);
+            hole = idx;
+        }
+        set_ctrl(hole, CTRL_EMPTY);
+    }
+
+    // moves the element at from into the free slot to, keeping its place in the iteration order
+    void relocate(size_type from, size_type to) {
+        Slot &src = m_slots[from];
+        Slot &dst = m_slots[to];
+        new(&dst.value) Value(std::move(src.value));
+        src.value.~Value();
+        if constexpr (linked) {
+            dst.prev = src.prev;
+            dst.next = src.next;
+            relink(to);
+        }
+        set_ctrl(to, m_ctrl[from]);
+        if constexpr (store_hash) {
+            m_hashes[to] = m_hashes[from];
+        }
+        if (m_tracked == from) {
+            m_tracked = to;
+        }
+    }
+
+    // exchanges the elements at a and b together with their places in the iteration order
+    void swap_slots(size_type a, size_type b) {
+        Slot &sa = m_slots[a];
+        Slot &sb = m_slots[b];
+        {
+            Value tmp(std::move(sa.value));
+            sa.value.~Value();
+            new(&sa.value) Value(std::move(sb.value));
+            sb.value.~Value();
+            new(&sb.value) Value(std::move(tmp));
+        }
+        auto swapped = [a, b](size_type i) {
+            return i == a ? b : i == b ? a : i;
+        };
+        if constexpr (linked) {
+            const size_type a_prev = sa.prev, a_next = sa.next;
+            sa.prev = swapped(sb.prev);
+            sa.next = swapped(sb.next);
+            sb.prev = swapped(a_prev);
+            sb.next = swapped(a_next);
+            relink(a);
+            relink(b);
+        }
+        const ctrl_t c = m_ctrl[a];
+        set_ctrl(a, m_ctrl[b]);
+        set_ctrl(b, c);
+        if constexpr (store_hash) {
+            std::swap(m_hashes[a], m_hashes[b]);
+        }
+        m_tracked = swapped(m_tracked);
+    }
+
+    // points the neighbours of the slot at idx back to it
+    void relink(size_type idx) {
+        const Slot &slot = m_slots[idx];
+        if (slot.prev != npos) {
+            m_slots[slot.prev].next = idx;
+        } else {
+            m_begin = idx;
+        }
+        if (slot.next != npos) {
+            m_slots[slot.next].prev = idx;
+        } else {
+            m_last = idx;
+        }
+    }
+
+    // Rehashes without reallocating: tombstones become empty, then every element is moved
+    // to the first non-full slot of its probe sequence, swapping with elements still to be
+    // processed.
+    void drop_tombstones() {
+        const size_type capacity = m_capacity;
+        for (size_type i = 0; i < capacity; ++i) {
+            set_ctrl(i, is_full(m_ctrl[i]) ? CTRL_DELETED : CTRL_EMPTY);
+        }
+        for (size_type i = 0; i < capacity; ++i) {
+            while (m_ctrl[i] == CTRL_DELETED) {
+                const size_type hash = slot_hash(i);
+                size_type group_pos = 0;
+                const size_type to = find_free(hash, &group_pos);
+                const size_type in_group = i >= group_pos ? i - group_pos : i + capacity - group_pos;
+                if (in_group < group_width) {
+                    set_ctrl(i, hash_tag(hash));
+                } else if (m_ctrl[to] == CTRL_EMPTY) {
+                    relocate(i, to);
+                    set_ctrl(to, hash_tag(hash));
+                    set_ctrl(i, CTRL_EMPTY);
+                } else {
+                    swap_slots(i, to);
+                    set_ctrl(to, hash_tag(hash));
+                }
+            }
+        }
+        m_deleted = 0;
+    }
+
+    void link_before(size_type idx, size_type hint) {
+        if constexpr (linked) {
+            size_type prev = (hint == npos ? m_last : m_slots[hint].prev);
+            if (prev != npos) {
+                m_slots[prev].next = idx;
+            } else { // если перед элементом никого, то он должен быть начальным
+                m_begin = idx;
+            }
+            m_slots[idx].prev = prev;
+            if (hint != npos) {
+                m_slots[hint].prev = idx;
+            } else { // если после элемента никого, то он последний
+                m_last = idx;
+            }
+            m_slots[idx].next = hint;
+        }
+    }
+
+    void unlink(size_type idx) {
+        const Slot &slot = m_slots[idx];
+        if (slot.next != npos) {
+            m_slots[slot.next].prev = slot.prev;
+        } else {
+            m_last = slot.prev;
+        }
+        if (slot.prev != npos) {
+            m_slots[slot.prev].next = slot.next;
+        } else {
+            m_begin = slot.next;
+        }
+    }
+
+    template<bool Const>
+    class Iterator {
+        friend class HashTable;
+
+        friend class Iterator<!Const>;
+
+        using slot_pointer = std::conditional_t<Const, const Slot *, Slot *>;
+        using table_pointer = std::conditional_t<Const, const HashTable *, HashTable *>;
+        // an incremental table may span two slot arrays and a slot order one needs the control
+        // bytes to find the next element, their iterators go through the table
+        using source_pointer = std::conditional_t<incremental || !linked, table_pointer, slot_pointer>;
+
+        source_pointer m_source;
+        size_type m_idx;
+
+        Iterator(source_pointer source, size_type idx) : m_source(source), m_idx(idx) {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const Value *, Value *>;
+        using reference = std::conditional_t<Const, const Value &, Value &>;
+
+        Iterator() : m_source(nullptr), m_idx(npos) {}
+
+        template<bool C = Const, class = std::enable_if_t<C>>
+        Iterator(const Iterator<false> &it) : m_source(it.m_source), m_idx(it.m_idx) {}
+
+        size_type index() const {
+            return m_idx;
+        }
+
+        Iterator &operator++() {
+            if constexpr (incremental || !linked) {
+                m_idx = m_source->next_index(m_idx);
+            } else {
+                m_idx = m_source[m_idx].next;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        reference operator*() const {
+            if constexpr (incremental || !linked) {
+                return m_source->value_at(m_idx);
+            } else {
+                return m_source[m_idx].value;
+            }
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        friend bool operator==(const Iterator &l, const Iterator &r) {
+            return l.m_idx == r.m_idx;
+        }
+
+        friend bool operator!=(const Iterator &l, const Iterator &r) {
+            return l.m_idx != r.m_idx;
+        }
+    };
+};
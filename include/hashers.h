@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Hash functions and the finalizer guarding the tables against weak ones. Everything here is
+// constexpr, so that tables can be built at compile time.
+
+namespace hashing {
+
+// the 128-bit product of a and b folded to 64 bits
+constexpr std::uint64_t fold_mul(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ using uint128 = unsigned __int128;
+    const uint128 product = static_cast<uint128>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+    const std::uint64_t a_lo = a & 0xFFFFFFFFu, a_hi = a >> 32;
+    const std::uint64_t b_lo = b & 0xFFFFFFFFu, b_hi = b >> 32;
+    const std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFu) + lo_hi;
+    const std::uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    const std::uint64_t lo = (cross << 32) | (lo_lo & 0xFFFFFFFFu);
+    return lo ^ hi;
+#endif
+}
+
+// Spreads every input bit over the whole result, the high bits (which give the hash tags) included.
+constexpr std::uint64_t mix64(std::uint64_t x) {
+    return fold_mul(x ^ 0x9E3779B97F4A7C15ULL, 0xBF58476D1CE4E5B9ULL);
+}
+
+inline constexpr std::uint64_t secret[4] = {
+        0xA0761D6478BD642FULL, 0xE7037ED1A0B428DBULL, 0x8EBC6AF09C88C6E3ULL, 0x589965CC75374CC3ULL
+};
+
+// little endian loads written byte by byte to stay constexpr, compilers merge them into one load
+constexpr std::uint64_t read64(const char *p) {
+    return static_cast<std::uint64_t>(static_cast<unsigned char>(p[0])) |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[1])) << 8 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[2])) << 16 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[3])) << 24 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[4])) << 32 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[5])) << 40 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[6])) << 48 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[7])) << 56;
+}
+
+constexpr std::uint64_t read32(const char *p) {
+    return static_cast<std::uint64_t>(static_cast<unsigned char>(p[0])) |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[1])) << 8 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[2])) << 16 |
+           static_cast<std::uint64_t>(static_cast<unsigned char>(p[3])) << 24;
+}
+
+// wyhash: 48 bytes per round in three independent lanes, short inputs read with overlapping loads
+constexpr std::uint64_t hash_bytes(const char *p, std::size_t len, std::uint64_t seed = 0) {
+    seed ^= fold_mul(seed ^ secret[0], secret[1]);
+    std::uint64_t a = 0, b = 0;
+    if (len <= 16) {
+        if (len >= 4) {
+            const std::size_t shift = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - shift);
+        } else if (len > 0) {
+            a = static_cast<std::uint64_t>(static_cast<unsigned char>(p[0])) << 16 |
+                static_cast<std::uint64_t>(static_cast<unsigned char>(p[len >> 1])) << 8 |
+                static_cast<std::uint64_t>(static_cast<unsigned char>(p[len - 1]));
+        }
+    } else {
+        std::size_t i = len;
+        if (i > 48) {
+            std::uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = fold_mul(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+                seed1 = fold_mul(read64(p + 16) ^ secret[2], read64(p + 24) ^ seed1);
+                seed2 = fold_mul(read64(p + 32) ^ secret[3], read64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = fold_mul(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+    return fold_mul(secret[1] ^ len, fold_mul(a ^ secret[1], b ^ seed));
+}
+
+} // namespace hashing
+
+// Hash for integers, enums and pointers: a single multiplication.
+struct IntegerHash {
+    template<class T, class = std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>>
+    constexpr std::size_t operator()(T value) const {
+        return static_cast<std::size_t>(hashing::mix64(static_cast<std::uint64_t>(value)));
+    }
+
+    template<class T>
+    std::size_t operator()(T *value) const {
+        return static_cast<std::size_t>(hashing::mix64(reinterpret_cast<std::uintptr_t>(value)));
+    }
+};
+
+// Hash for byte strings. Transparent, so that a table of strings can be searched with string
+// views or literals when its key comparator is transparent too, such as std::equal_to<>.
+struct BytesHash {
+    using is_transparent = void;
+
+    constexpr std::size_t operator()(std::string_view s) const {
+        return static_cast<std::size_t>(hashing::hash_bytes(s.data(), s.size()));
+    }
+
+    std::size_t operator()(const std::string &s) const {
+        return operator()(std::string_view(s));
+    }
+
+    constexpr std::size_t operator()(const char *s) const {
+        return operator()(std::string_view(s));
+    }
+};
+
+// A hasher whose results are passed through hashing::mix64.
+template<class Hash>
+struct MixedHash : Hash {
+    MixedHash() = default;
+
+    MixedHash(const Hash &hash) : Hash(hash) {}
+
+    template<class K>
+    constexpr std::size_t operator()(const K &key) const {
+        return static_cast<std::size_t>(hashing::mix64(static_cast<std::uint64_t>(Hash::operator()(key))));
+    }
+};
+
+// Hashers which are known to give poorly distributed values: the standard library hashes of
+// integers, enums and pointers are the value itself with libstdc++ and libc++. Sequential or
+// strided keys then cluster under linear probing and all share the same tag. Specialize to
+// have other hashers finalized too.
+template<class Hash>
+struct is_weak_hash : std::false_type {
+};
+
+template<class T>
+struct is_weak_hash<std::hash<T>>
+        : std::bool_constant<std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>> {
+};
+
+// The hasher the containers actually use for Hash: weak ones get finalized by MixedHash.
+template<class Hash>
+struct guarded_hash {
+    using type = std::conditional_t<is_weak_hash<Hash>::value, MixedHash<Hash>, Hash>;
+};
+
+template<class Hash>
+using guarded_hash_t = typename guarded_hash<Hash>::type;
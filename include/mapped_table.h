@@ -0,0 +1,496 @@
+#pragma once
+
+#include "group.h"
+#include "hashers.h"
+#include "policy.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Persistent read-only tables for trivially copyable keys and values. A file is written once
+// from any range of elements and later mapped with mmap: lookups probe the mapped control bytes
+// and entries in place, so opening a table costs a few system calls and a lookup pays only for
+// the pages it touches. The layout does not depend on the policies of the table it was written
+// from nor on the SIMD flags of the build: group probing over eight control bytes with Fibonacci
+// hashing over a power of two capacity, entries stored without links.
+//
+// Layout: MappedHeader, the control bytes (capacity plus the mirrored group tail), padding up to
+// the entry alignment, then capacity entries. Every field has a fixed size and the byte order is
+// checked on open, files are not portable across endianness. Hash must give the same values in
+// the reading process as in the writing one; a checksum of the hashes of a few stored keys
+// catches a hasher that changed.
+namespace mapped {
+
+inline constexpr char magic[8] = {'O', 'A', 'H', 'T', 'M', 'A', 'P', '\0'};
+inline constexpr std::uint32_t format_version = 1;
+inline constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+struct MappedHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t group_width;
+    std::uint32_t entry_align;
+    std::uint64_t key_size;
+    std::uint64_t entry_size;
+    std::uint64_t capacity;
+    std::uint64_t size;
+    std::uint64_t hash_check;
+    std::uint64_t entries_offset;
+    std::uint64_t file_size;
+};
+
+static_assert(std::is_trivially_copyable_v<MappedHeader> && sizeof(MappedHeader) == 80);
+
+using group_type = PortableGroup;
+
+// max load of written files, no erase ever happens so there are no tombstones to account for
+inline constexpr double max_load_factor = 0.75;
+
+// keys whose hashes go into MappedHeader::hash_check, taken in slot order
+inline constexpr std::size_t hash_check_keys = 16;
+
+inline std::uint64_t align_up(std::uint64_t offset, std::uint64_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+inline std::size_t capacity_for(std::size_t size) {
+    std::size_t capacity = 16;
+    while (static_cast<double>(size) > max_load_factor * static_cast<double>(capacity)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// groups probed before every slot has been seen once, capacities being multiples of the width
+inline std::size_t group_count(std::size_t capacity) {
+    return capacity / group_type::width;
+}
+
+inline std::size_t next_group(std::size_t pos, std::size_t capacity) {
+    return pos + group_type::width < capacity ? pos + group_type::width : pos + group_type::width - capacity;
+}
+
+// read-only POSIX mapping of a whole file
+class FileMapping {
+public:
+    FileMapping() = default;
+
+    explicit FileMapping(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("mapped table: cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::runtime_error("mapped table: cannot stat " + path + ": " + std::strerror(err));
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size > 0) {
+            void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::runtime_error("mapped table: cannot map " + path + ": " + std::strerror(err));
+            }
+            m_data = data;
+        }
+        // the mapping outlives the descriptor
+        ::close(fd);
+    }
+
+    FileMapping(FileMapping &&other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+    FileMapping &operator=(FileMapping other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    ~FileMapping() {
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_size);
+        }
+    }
+
+    const unsigned char *data() const {
+        return static_cast<const unsigned char *>(m_data);
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    void *m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+// Shared part of MappedHashSet and MappedHashMap. Entry is stored as is in the file, KeyOf
+// extracts its key.
+template<class Key, class Entry, class KeyOf, class Hash, class Equal>
+class MappedTable {
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Entry>,
+                  "mapped tables store keys and values as raw bytes");
+
+public:
+    using size_type = std::size_t;
+
+    // Lays the elements of [first, last) out the way they will be mapped and writes the file.
+    // make_entry turns an element into an Entry; the first of equal keys wins.
+    template<class InputIt, class MakeEntry>
+    static void write(const std::string &path, InputIt first, InputIt last, MakeEntry make_entry,
+                      const Hash &hash, const Equal &equal) {
+        std::vector<Entry> input;
+        for (; first != last; ++first) {
+            input.push_back(make_entry(*first));
+        }
+        const size_type capacity = capacity_for(input.size());
+        std::vector<ctrl_t> ctrl(capacity + group_type::width - 1, CTRL_EMPTY);
+        // value initialized so that empty slots are written as zeroes
+        std::vector<Entry> entries(capacity);
+        size_type size = 0;
+        for (const Entry &entry : input) {
+            const Key &key = KeyOf::get(entry);
+            const size_type h = hash(key);
+            const ctrl_t tag = hash_tag(h);
+            bool placed = false;
+            size_type pos = FibonacciReducer::index(h, capacity);
+            for (size_type g = 0; g < group_count(capacity) && !placed; ++g, pos = next_group(pos, capacity)) {
+                const group_type group(&ctrl[pos]);
+                bool present = false;
+                for (unsigned i : group.match(tag)) {
+                    const size_type idx = (pos + i) & (capacity - 1);
+                    if (equal(KeyOf::get(entries[idx]), key)) {
+                        present = true;
+                        break;
+                    }
+                }
+                if (present) {
+                    placed = true;
+                } else if (auto empty = group.match_empty()) {
+                    const size_type idx = (pos + empty.lowest()) & (capacity - 1);
+                    ctrl[idx] = tag;
+                    if (idx < group_type::width - 1) {
+                        ctrl[capacity + idx] = tag;
+                    }
+                    std::memcpy(static_cast<void *>(&entries[idx]), &entry, sizeof(Entry));
+                    ++size;
+                    placed = true;
+                }
+            }
+            // capacity_for leaves a quarter of the slots empty
+            if (!placed) {
+                throw std::logic_error("mapped table: no empty slot left for a key");
+            }
+        }
+
+        MappedHeader header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = format_version;
+        header.byte_order = byte_order_mark;
+        header.group_width = group_type::width;
+        header.entry_align = alignof(Entry);
+        header.key_size = sizeof(Key);
+        header.entry_size = sizeof(Entry);
+        header.capacity = capacity;
+        header.size = size;
+        header.hash_check = hash_check_of(ctrl.data(), entries.data(), capacity, hash);
+        header.entries_offset = align_up(sizeof(MappedHeader) + ctrl.size(), alignof(Entry));
+        header.file_size = header.entries_offset + capacity * sizeof(Entry);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        const std::vector<char> padding(header.entries_offset - sizeof(MappedHeader) - ctrl.size(), 0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(ctrl.data()), static_cast<std::streamsize>(ctrl.size()));
+        out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        out.write(reinterpret_cast<const char *>(entries.data()),
+                  static_cast<std::streamsize>(capacity * sizeof(Entry)));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("mapped table: cannot write " + path);
+        }
+    }
+
+    MappedTable(const std::string &path, const Hash &hash, const Equal &equal)
+            : m_file(path), m_hash(hash), m_equal(equal) {
+        if (m_file.size() < sizeof(MappedHeader)) {
+            throw std::runtime_error("mapped table: " + path + " is truncated");
+        }
+        MappedHeader header;
+        std::memcpy(&header, m_file.data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("mapped table: " + path + " is not a mapped table");
+        }
+        if (header.version != format_version || header.byte_order != byte_order_mark) {
+            throw std::runtime_error("mapped table: " + path + " has an unsupported version or byte order");
+        }
+        if (header.group_width != group_type::width || header.entry_align != alignof(Entry) ||
+            header.key_size != sizeof(Key) || header.entry_size != sizeof(Entry)) {
+            throw std::runtime_error("mapped table: " + path + " was written for other key or value types");
+        }
+        const std::uint64_t capacity = header.capacity;
+        if (capacity < group_type::width || (capacity & (capacity - 1)) != 0 || header.size >= capacity ||
+            header.entries_offset < sizeof(MappedHeader) + capacity + group_type::width - 1 ||
+            header.entries_offset % alignof(Entry) != 0 ||
+            header.file_size != header.entries_offset + capacity * sizeof(Entry) ||
+            header.file_size != m_file.size()) {
+            throw std::runtime_error("mapped table: " + path + " is corrupted");
+        }
+        m_capacity = static_cast<size_type>(capacity);
+        m_size = static_cast<size_type>(header.size);
+        m_ctrl = reinterpret_cast<const ctrl_t *>(m_file.data() + sizeof(MappedHeader));
+        m_entries = reinterpret_cast<const Entry *>(m_file.data() + header.entries_offset);
+        if (hash_check_of(m_ctrl, m_entries, m_capacity, m_hash) != header.hash_check) {
+            throw std::runtime_error("mapped table: " + path + " was written with another hash function");
+        }
+    }
+
+    size_type size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    size_type capacity() const {
+        return m_capacity;
+    }
+
+    const Entry *find_entry(const Key &key) const {
+        const size_type h = m_hash(key);
+        const ctrl_t tag = hash_tag(h);
+        // bounded, a corrupted file may have no empty slot
+        size_type pos = FibonacciReducer::index(h, m_capacity);
+        for (size_type g = 0; g < group_count(m_capacity); ++g, pos = next_group(pos, m_capacity)) {
+            const group_type group(m_ctrl + pos);
+            for (unsigned i : group.match(tag)) {
+                const Entry &entry = m_entries[(pos + i) & (m_capacity - 1)];
+                if (m_equal(KeyOf::get(entry), key)) {
+                    return &entry;
+                }
+            }
+            if (group.match_empty()) {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // calls f for every entry, in slot order
+    template<class F>
+    void for_each_entry(F f) const {
+        for (size_type i = 0; i < m_capacity; ++i) {
+            if (is_full(m_ctrl[i])) {
+                f(m_entries[i]);
+            }
+        }
+    }
+
+private:
+    FileMapping m_file;
+    const ctrl_t *m_ctrl = nullptr;
+    const Entry *m_entries = nullptr;
+    size_type m_capacity = 0;
+    size_type m_size = 0;
+    Hash m_hash;
+    Equal m_equal;
+
+    static std::uint64_t hash_check_of(const ctrl_t *ctrl, const Entry *entries, size_type capacity, const Hash &hash) {
+        std::uint64_t check = 0;
+        size_type taken = 0;
+        for (size_type i = 0; i < capacity && taken < hash_check_keys; ++i) {
+            if (is_full(ctrl[i])) {
+                ++taken;
+                check = (check ^ static_cast<std::uint64_t>(hash(KeyOf::get(entries[i])))) * 0x9E3779B97F4A7C15ULL;
+            }
+        }
+        return check;
+    }
+};
+
+} // namespace mapped
+
+// Read-only set mapped from a file written by MappedHashSet::write.
+template<
+        class Key,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>
+>
+class MappedHashSet {
+    struct KeyOf {
+        static const Key &get(const Key &key) {
+            return key;
+        }
+    };
+
+    using Table = mapped::MappedTable<Key, Key, KeyOf, guarded_hash_t<Hash>, Equal>;
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+
+    template<class InputIt>
+    static void write(const std::string &path, InputIt first, InputIt last,
+                      const hasher &hash = hasher(), const key_equal &equal = key_equal()) {
+        Table::write(path, first, last, [](const Key &key) { return key; }, hash, equal);
+    }
+
+    // any range of keys, a HashSet for one
+    template<class Container>
+    static void write(const std::string &path, const Container &keys,
+                      const hasher &hash = hasher(), const key_equal &equal = key_equal()) {
+        write(path, keys.begin(), keys.end(), hash, equal);
+    }
+
+    explicit MappedHashSet(const std::string &path, const hasher &hash = hasher(), const key_equal &equal = key_equal())
+            : m_table(path, hash, equal) {}
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    bool empty() const {
+        return m_table.empty();
+    }
+
+    size_type capacity() const {
+        return m_table.capacity();
+    }
+
+    // the key inside the mapping, valid as long as the set is alive
+    const Key *find(const Key &key) const {
+        return m_table.find_entry(key);
+    }
+
+    bool contains(const Key &key) const {
+        return find(key) != nullptr;
+    }
+
+    size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    template<class F>
+    void for_each(F f) const {
+        m_table.for_each_entry(f);
+    }
+
+private:
+    Table m_table;
+};
+
+// Read-only map mapped from a file written by MappedHashMap::write.
+template<
+        class Key,
+        class T,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>
+>
+class MappedHashMap {
+    // std::pair is not trivially copyable, the file holds this instead
+    struct Entry {
+        Key key;
+        T value;
+    };
+
+    struct KeyOf {
+        static const Key &get(const Entry &entry) {
+            return entry.key;
+        }
+    };
+
+    using Table = mapped::MappedTable<Key, Entry, KeyOf, guarded_hash_t<Hash>, Equal>;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = std::size_t;
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+
+    // elements of [first, last) are anything with first and second, such as the values of a HashMap
+    template<class InputIt>
+    static void write(const std::string &path, InputIt first, InputIt last,
+                      const hasher &hash = hasher(), const key_equal &equal = key_equal()) {
+        Table::write(path, first, last, [](const auto &value) {
+            Entry entry{};
+            entry.key = value.first;
+            entry.value = value.second;
+            return entry;
+        }, hash, equal);
+    }
+
+    template<class Container>
+    static void write(const std::string &path, const Container &values,
+                      const hasher &hash = hasher(), const key_equal &equal = key_equal()) {
+        write(path, values.begin(), values.end(), hash, equal);
+    }
+
+    explicit MappedHashMap(const std::string &path, const hasher &hash = hasher(), const key_equal &equal = key_equal())
+            : m_table(path, hash, equal) {}
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    bool empty() const {
+        return m_table.empty();
+    }
+
+    size_type capacity() const {
+        return m_table.capacity();
+    }
+
+    // the mapped value inside the mapping, valid as long as the map is alive
+    const T *find(const Key &key) const {
+        const Entry *entry = m_table.find_entry(key);
+        return entry != nullptr ? &entry->value : nullptr;
+    }
+
+    bool contains(const Key &key) const {
+        return m_table.find_entry(key) != nullptr;
+    }
+
+    size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    const T &at(const Key &key) const {
+        const T *value = find(key);
+        if (value == nullptr) {
+            throw std::out_of_range("MappedHashMap::at");
+        }
+        return *value;
+    }
+
+    // calls f(key, value) for every element
+    template<class F>
+    void for_each(F f) const {
+        m_table.for_each_entry([&f](const Entry &entry) {
+            f(entry.key, entry.value);
+        });
+    }
+
+private:
+    Table m_table;
+};
@@ -0,0 +1,778 @@
+#pragma once
+
+#include "hash_table.h"
+#include "hashers.h"
+#include "policy.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A map iterating in insertion order, laid out like the dictionaries of CPython: the elements
+// are appended to a dense array of entries and the open addressing table only holds their
+// 32-bit positions, so a slot costs four bytes whatever the element size and iteration is a
+// walk over the entries. Every entry keeps the full hash of its key, which filters the key
+// comparisons and spares the hasher calls on rehash.
+// Erasing destroys the element in place, leaving a hole in the entries and a tombstone in the
+// table; the next rehash drops both, compacting the entries in their order. Assigning to an
+// existing key keeps its position.
+// Iterators are positions in the entries: they survive inserts and erases, but not rehashes,
+// and references do not survive the inserts which grow the entries, as with std::vector.
+// The collision policy must probe slot by slot, LinearProbing or QuadraticProbing, the latter
+// with power of two capacities.
+template<
+        class Key,
+        class T,
+        class CollisionPolicy = LinearProbing,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<std::pair<const Key, T>>
+>
+class OrderedHashMap {
+    static_assert(CollisionPolicy::group_type::width == 1 && !is_robin_hood<CollisionPolicy>::value,
+                  "the table of positions is probed slot by slot");
+    static_assert(!Reducer::power_of_two || GrowthPolicy::power_of_two,
+                  "the reducer needs a growth policy producing power of two capacities");
+    static_assert(!needs_power_of_two<CollisionPolicy>::value || GrowthPolicy::power_of_two,
+                  "the collision policy only covers power of two capacities");
+
+    template<bool Const>
+    class Iterator;
+
+public:
+    // types
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    // Hash itself unless it is weak, see is_weak_hash
+    using hasher = guarded_hash_t<Hash>;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    static constexpr float default_max_load_factor = 0.5f;
+
+private:
+    using index_type = std::uint32_t;
+
+    static constexpr index_type empty_slot = std::numeric_limits<index_type>::max();
+    static constexpr index_type deleted_slot = empty_slot - 1;
+    // positions stay below the slot markers
+    static constexpr size_type max_entries = deleted_slot;
+    // the hash of a hole, a key hashing to it is given the hash below
+    static constexpr size_type hole = npos;
+
+    template<class K>
+    using transparent_key = std::enable_if_t<is_transparent_lookup<Hash, Equal>::value &&
+                                             !std::is_convertible_v<const K &, const_iterator> &&
+                                             !std::is_convertible_v<const K &, iterator>, K>;
+
+public:
+    explicit OrderedHashMap(size_type expected_max_size = 1,
+                            const hasher &hash = hasher(),
+                            const key_equal &equal = key_equal(),
+                            const allocator_type &alloc = allocator_type())
+            : m_hash(hash), m_equal(equal), m_alloc(alloc) {
+        if (expected_max_size > 0) {
+            rehash_impl(capacity_for(expected_max_size));
+        }
+    }
+
+    explicit OrderedHashMap(const allocator_type &alloc) : OrderedHashMap(1, hasher(), key_equal(), alloc) {}
+
+    template<class InputIt>
+    OrderedHashMap(InputIt first, InputIt last,
+                   size_type expected_max_size = 1,
+                   const hasher &hash = hasher(),
+                   const key_equal &equal = key_equal(),
+                   const allocator_type &alloc = allocator_type())
+            : OrderedHashMap(expected_max_size, hash, equal, alloc) {
+        insert(first, last);
+    }
+
+    OrderedHashMap(std::initializer_list<value_type> init,
+                   size_type expected_max_size = 0,
+                   const hasher &hash = hasher(),
+                   const key_equal &equal = key_equal(),
+                   const allocator_type &alloc = allocator_type())
+            : OrderedHashMap(init.begin(), init.end(), expected_max_size, hash, equal, alloc) {}
+
+    OrderedHashMap(const OrderedHashMap &other)
+            : OrderedHashMap(other, alloc_traits::select_on_container_copy_construction(other.m_alloc)) {}
+
+    OrderedHashMap(const OrderedHashMap &other, const allocator_type &alloc)
+            : OrderedHashMap(0, other.m_hash, other.m_equal, alloc) {
+        m_max_load = other.m_max_load;
+        copy_entries(other);
+    }
+
+    OrderedHashMap(OrderedHashMap &&other) noexcept
+            : OrderedHashMap(0, other.m_hash, other.m_equal, other.m_alloc) {
+        steal(other);
+    }
+
+    OrderedHashMap &operator=(const OrderedHashMap &other) {
+        if (this != &other) {
+            OrderedHashMap tmp(other, alloc_traits::propagate_on_container_copy_assignment::value ? other.m_alloc : m_alloc);
+            release();
+            if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                m_alloc = other.m_alloc;
+            }
+            steal(tmp);
+        }
+        return *this;
+    }
+
+    OrderedHashMap &operator=(OrderedHashMap &&other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                                               alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        release();
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+            m_alloc = other.m_alloc;
+        } else if (!(m_alloc == other.m_alloc)) {
+            // the arrays of other cannot be freed with our allocator, so the elements are moved one by one
+            m_max_load = other.m_max_load;
+            m_hash = other.m_hash;
+            m_equal = other.m_equal;
+            reserve(other.m_size);
+            for (size_type i = other.next_live(0); i != npos; i = other.next_live(i + 1)) {
+                append(other.m_entries[i].hash, std::move(other.m_entries[i].value));
+            }
+            other.clear();
+            return *this;
+        }
+        steal(other);
+        return *this;
+    }
+
+    OrderedHashMap &operator=(std::initializer_list<value_type> init) {
+        clear();
+        reserve(init.size());
+        insert(init);
+        return *this;
+    }
+
+    ~OrderedHashMap() {
+        release();
+    }
+
+    iterator begin() noexcept {
+        return iterator(this, next_live(m_first));
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(this, next_live(m_first));
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    iterator end() noexcept {
+        return iterator(this, npos);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(this, npos);
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    size_type size() const {
+        return m_size;
+    }
+
+    allocator_type get_allocator() const {
+        return m_alloc;
+    }
+
+    size_type max_size() const {
+        return m_capacity;
+    }
+
+    // the positions keep their table, the holes left are reused
+    void clear() {
+        destroy_entries();
+        std::fill(m_index, m_index + m_capacity, empty_slot);
+        m_used = 0;
+        m_size = 0;
+        m_first = 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        return wrap(emplace_unique(value.first, value));
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value) {
+        return wrap(emplace_unique(value.first, std::move(value)));
+    }
+
+    template<class P, class = std::enable_if_t<std::is_constructible_v<value_type, P &&>>>
+    std::pair<iterator, bool> insert(P &&value) {
+        return emplace(std::forward<P>(value));
+    }
+
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (auto it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    void insert(std::initializer_list<value_type> init) {
+        insert(init.begin(), init.end());
+    }
+
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&value) {
+        return wrap(assign_impl(key, std::forward<M>(value)));
+    }
+
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&value) {
+        return wrap(assign_impl(std::move(key), std::forward<M>(value)));
+    }
+
+    // the key is looked up before anything is constructed when the arguments are a key and
+    // a mapped value, otherwise the element is built first
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        return wrap(emplace_impl(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const key_type &key, Args &&... args) {
+        return wrap(try_emplace_impl(key, std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(key_type &&key, Args &&... args) {
+        return wrap(try_emplace_impl(std::move(key), std::forward<Args>(args)...));
+    }
+
+    // nothing is moved by an erase, so the iterators to the other elements stay valid
+    iterator erase(const_iterator pos) {
+        if (pos.m_pos == npos) {
+            return end();
+        }
+        const Entry &entry = m_entries[pos.m_pos];
+        erase_slot(find_slot(entry.value.first, entry.hash));
+        return iterator(this, next_live(pos.m_pos + 1));
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        while (first != last) {
+            first = erase(first);
+        }
+        return iterator(this, first.m_pos);
+    }
+
+    size_type erase(const key_type &key) {
+        return erase_key(key);
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type erase(const K &key) {
+        return erase_key(key);
+    }
+
+    void swap(OrderedHashMap &other) noexcept {
+        steal(other);
+        if constexpr (alloc_traits::propagate_on_container_swap::value) {
+            std::swap(m_alloc, other.m_alloc);
+        }
+    }
+
+    size_type count(const key_type &key) const {
+        return find_position(key) == npos ? 0 : 1;
+    }
+
+    template<class K, class = transparent_key<K>>
+    size_type count(const K &key) const {
+        return find_position(key) == npos ? 0 : 1;
+    }
+
+    iterator find(const key_type &key) {
+        return iterator(this, find_position(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    iterator find(const K &key) {
+        return iterator(this, find_position(key));
+    }
+
+    const_iterator find(const key_type &key) const {
+        return const_iterator(this, find_position(key));
+    }
+
+    template<class K, class = transparent_key<K>>
+    const_iterator find(const K &key) const {
+        return const_iterator(this, find_position(key));
+    }
+
+    bool contains(const key_type &key) const {
+        return find_position(key) != npos;
+    }
+
+    template<class K, class = transparent_key<K>>
+    bool contains(const K &key) const {
+        return find_position(key) != npos;
+    }
+
+    mapped_type &at(const key_type &key) {
+        return m_entries[existing_position(key)].value.second;
+    }
+
+    template<class K, class = transparent_key<K>>
+    mapped_type &at(const K &key) {
+        return m_entries[existing_position(key)].value.second;
+    }
+
+    const mapped_type &at(const key_type &key) const {
+        return m_entries[existing_position(key)].value.second;
+    }
+
+    template<class K, class = transparent_key<K>>
+    const mapped_type &at(const K &key) const {
+        return m_entries[existing_position(key)].value.second;
+    }
+
+    mapped_type &operator[](const key_type &key) {
+        return try_emplace(key).first->second;
+    }
+
+    mapped_type &operator[](key_type &&key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    size_type bucket_count() const {
+        return m_capacity;
+    }
+
+    float load_factor() const {
+        return m_capacity == 0 ? 0.0f : static_cast<float>(m_size) / static_cast<float>(m_capacity);
+    }
+
+    float max_load_factor() const {
+        return m_max_load;
+    }
+
+    // the table always keeps an empty slot, so the factor is clamped to [1/16, 15/16]
+    void max_load_factor(float ml) {
+        m_max_load = std::min(std::max(ml, 0.0625f), 0.9375f);
+        rehash_impl(capacity_for(m_size));
+    }
+
+    // compacts the entries, and resizes the table to hold count elements when it is larger
+    // than the one needed for the current ones
+    void rehash(size_type count) {
+        rehash_impl(capacity_for(std::max(count, m_size)));
+    }
+
+    void reserve(size_type count) {
+        if (count > m_limit) {
+            rehash_impl(capacity_for(count));
+        }
+    }
+
+    // the elements which were erased but still take room in the entries
+    size_type holes() const {
+        return m_used - m_size;
+    }
+
+    // compare two containers contents, in any order
+    friend bool operator==(const OrderedHashMap &lhs, const OrderedHashMap &rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (const auto &value : lhs) {
+            auto el = rhs.find(value.first);
+            if (el == rhs.end() || !(value.second == el->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const OrderedHashMap &lhs, const OrderedHashMap &rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    struct Entry {
+        size_type hash;
+        union {
+            value_type value;
+        };
+
+        Entry() {}
+
+        Entry(const Entry &) = delete;
+
+        ~Entry() {}
+    };
+
+    using alloc_traits = std::allocator_traits<Allocator>;
+
+    Entry *m_entries = nullptr;
+    index_type *m_index = nullptr;
+    size_type m_capacity = 0;
+    // entries allocated, the positions the table holds before it is rehashed
+    size_type m_limit = 0;
+    // entries appended since the last rehash, holes included
+    size_type m_used = 0;
+    size_type m_size = 0;
+    // no element is stored before this position
+    size_type m_first = 0;
+    float m_max_load = default_max_load_factor;
+    hasher m_hash;
+    Equal m_equal;
+    Allocator m_alloc;
+
+    template<bool Const>
+    class Iterator {
+        friend class OrderedHashMap;
+
+        friend class Iterator<!Const>;
+
+        using map_pointer = std::conditional_t<Const, const OrderedHashMap *, OrderedHashMap *>;
+
+        map_pointer m_map;
+        size_type m_pos;
+
+        Iterator(map_pointer map, size_type pos) : m_map(map), m_pos(pos) {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename OrderedHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+
+        Iterator() : m_map(nullptr), m_pos(npos) {}
+
+        template<bool C = Const, class = std::enable_if_t<C>>
+        Iterator(const Iterator<false> &it) : m_map(it.m_map), m_pos(it.m_pos) {}
+
+        // the position of the element in the entries
+        size_type index() const {
+            return m_pos;
+        }
+
+        Iterator &operator++() {
+            m_pos = m_map->next_live(m_pos + 1);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        reference operator*() const {
+            return m_map->m_entries[m_pos].value;
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        friend bool operator==(const Iterator &l, const Iterator &r) {
+            return l.m_pos == r.m_pos;
+        }
+
+        friend bool operator!=(const Iterator &l, const Iterator &r) {
+            return l.m_pos != r.m_pos;
+        }
+    };
+
+    template<class K>
+    size_type hash_of(const K &key) const {
+        const size_type hash = m_hash(key);
+        return hash == hole ? hash - 1 : hash;
+    }
+
+    size_type capacity_for(size_type count) const {
+        return static_cast<size_type>(std::ceil(static_cast<float>(count) / m_max_load));
+    }
+
+    // the entries a table of capacity slots holds, leaving an empty slot at least
+    size_type limit_for(size_type capacity) const {
+        const auto limit = static_cast<size_type>(static_cast<float>(capacity) * m_max_load);
+        return std::min(std::min(limit, capacity - 1), max_entries);
+    }
+
+    // the first element at or after pos
+    size_type next_live(size_type pos) const {
+        for (; pos < m_used; ++pos) {
+            if (m_entries[pos].hash != hole) {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    // the slot holding the position of key, npos if it is absent
+    template<class K>
+    size_type find_slot(const K &key, size_type hash) const {
+        if (m_size == 0) {
+            return npos;
+        }
+        size_type pos = Reducer::index(hash, m_capacity);
+        for (size_type step_num = 1; step_num <= m_capacity; pos = CollisionPolicy::next(pos, step_num++, m_capacity)) {
+            const index_type i = m_index[pos];
+            if (i == empty_slot) {
+                return npos;
+            }
+            if (i != deleted_slot && m_entries[i].hash == hash && m_equal(m_entries[i].value.first, key)) {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    template<class K>
+    size_type find_position(const K &key) const {
+        const size_type slot = find_slot(key, hash_of(key));
+        return slot == npos ? npos : m_index[slot];
+    }
+
+    template<class K>
+    size_type existing_position(const K &key) const {
+        const size_type pos = find_position(key);
+        if (pos == npos) {
+            throw std::out_of_range("OrderedHashMap::at");
+        }
+        return pos;
+    }
+
+    // The first slot of the probe sequence without a position, tombstones are reused. The
+    // sequence covers the table, which always has a free slot, within as many steps as
+    // find_slot takes.
+    size_type find_free(size_type hash) const {
+        size_type pos = Reducer::index(hash, m_capacity);
+        for (size_type step_num = 1; step_num <= m_capacity; pos = CollisionPolicy::next(pos, step_num++, m_capacity)) {
+            if (m_index[pos] >= deleted_slot) {
+                return pos;
+            }
+        }
+        throw std::length_error("OrderedHashMap: no free slot on the probe sequence");
+    }
+
+    // constructs the element from args at the end of the entries unless key is present
+    template<class K, class... Args>
+    std::pair<size_type, bool> emplace_unique(const K &key, Args &&... args) {
+        const size_type hash = hash_of(key);
+        const size_type slot = find_slot(key, hash);
+        if (slot != npos) {
+            return {m_index[slot], false};
+        }
+        return {append(hash, std::forward<Args>(args)...), true};
+    }
+
+    // appends an element known to be absent, growing the entries or compacting them when
+    // they are full
+    template<class... Args>
+    size_type append(size_type hash, Args &&... args) {
+        if (m_used == m_limit) {
+            if (m_size + 1 > max_entries) {
+                throw std::length_error("OrderedHashMap: too many elements");
+            }
+            // holes taking half of the entries are compacted without growing
+            const bool compact = m_size < m_limit / 2;
+            rehash_impl(compact ? m_capacity : std::max(GrowthPolicy::next(m_capacity), capacity_for(m_size + 1)));
+        }
+        Entry &entry = m_entries[m_used];
+        new(&entry.value) value_type(std::forward<Args>(args)...);
+        entry.hash = hash;
+        m_index[find_free(hash)] = static_cast<index_type>(m_used);
+        ++m_size;
+        return m_used++;
+    }
+
+    void erase_slot(size_type slot) {
+        const size_type pos = m_index[slot];
+        m_index[slot] = deleted_slot;
+        Entry &entry = m_entries[pos];
+        entry.value.~value_type();
+        entry.hash = hole;
+        --m_size;
+        if (pos == m_first) {
+            const size_type next = next_live(pos + 1);
+            m_first = next == npos ? m_used : next;
+        }
+    }
+
+    template<class K>
+    size_type erase_key(const K &key) {
+        const size_type slot = find_slot(key, hash_of(key));
+        if (slot == npos) {
+            return 0;
+        }
+        erase_slot(slot);
+        return 1;
+    }
+
+    // moves the elements into fresh arrays, in their order and without the holes
+    void rehash_impl(size_type new_capacity) {
+        new_capacity = GrowthPolicy::fit(std::max<size_type>(new_capacity, 2));
+        while (limit_for(new_capacity) < std::max<size_type>(m_size, 1)) {
+            new_capacity = GrowthPolicy::next(new_capacity);
+        }
+        const size_type limit = limit_for(new_capacity);
+        Entry *entries = allocate_array<Entry>(limit);
+        index_type *index;
+        try {
+            index = allocate_array<index_type>(new_capacity);
+        } catch (...) {
+            deallocate_array(entries, limit);
+            throw;
+        }
+        std::fill(index, index + new_capacity, empty_slot);
+        Entry *old_entries = m_entries;
+        index_type *old_index = m_index;
+        const size_type old_capacity = m_capacity, old_limit = m_limit, old_used = m_used;
+        m_entries = entries;
+        m_index = index;
+        m_capacity = new_capacity;
+        m_limit = limit;
+        m_used = 0;
+        for (size_type i = m_first; i < old_used; ++i) {
+            Entry &from = old_entries[i];
+            if (from.hash != hole) {
+                Entry &to = m_entries[m_used];
+                new(&to.value) value_type(std::move(from.value));
+                to.hash = from.hash;
+                from.value.~value_type();
+                m_index[find_free(to.hash)] = static_cast<index_type>(m_used++);
+            }
+        }
+        m_first = 0;
+        deallocate_array(old_entries, old_limit);
+        deallocate_array(old_index, old_capacity);
+    }
+
+    void copy_entries(const OrderedHashMap &other) {
+        reserve(other.m_size);
+        for (size_type i = other.next_live(other.m_first); i != npos; i = other.next_live(i + 1)) {
+            append(other.m_entries[i].hash, other.m_entries[i].value);
+        }
+    }
+
+    void destroy_entries() {
+        for (size_type i = m_first; i < m_used; ++i) {
+            if (m_entries[i].hash != hole) {
+                m_entries[i].value.~value_type();
+                m_entries[i].hash = hole;
+            }
+        }
+    }
+
+    void release() {
+        destroy_entries();
+        deallocate_array(m_entries, m_limit);
+        deallocate_array(m_index, m_capacity);
+        m_entries = nullptr;
+        m_index = nullptr;
+        m_capacity = m_limit = m_used = m_size = m_first = 0;
+    }
+
+    // exchanges the arrays and the state, but not the allocators
+    void steal(OrderedHashMap &other) noexcept {
+        std::swap(m_entries, other.m_entries);
+        std::swap(m_index, other.m_index);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_limit, other.m_limit);
+        std::swap(m_used, other.m_used);
+        std::swap(m_size, other.m_size);
+        std::swap(m_first, other.m_first);
+        std::swap(m_max_load, other.m_max_load);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+    template<class U>
+    U *allocate_array(size_type n) {
+        typename alloc_traits::template rebind_alloc<U> alloc(m_alloc);
+        return std::allocator_traits<decltype(alloc)>::allocate(alloc, n);
+    }
+
+    template<class U>
+    void deallocate_array(U *p, size_type n) {
+        if (p != nullptr) {
+            typename alloc_traits::template rebind_alloc<U> alloc(m_alloc);
+            std::allocator_traits<decltype(alloc)>::deallocate(alloc, p, n);
+        }
+    }
+
+    std::pair<iterator, bool> wrap(std::pair<size_type, bool> res) {
+        return std::make_pair(iterator(this, res.first), res.second);
+    }
+
+    template<class A>
+    static constexpr bool is_key = std::is_same_v<std::remove_cv_t<std::remove_reference_t<A>>, Key>;
+
+    template<class K, class... Args>
+    std::pair<size_type, bool> try_emplace_impl(K &&key, Args &&... args) {
+        return emplace_unique(key,
+                              std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<K>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class K, class M>
+    std::pair<size_type, bool> assign_impl(K &&key, M &&value) {
+        auto res = emplace_unique(key, std::forward<K>(key), std::forward<M>(value));
+        if (!res.second) {
+            m_entries[res.first].value.second = std::forward<M>(value);
+        }
+        return res;
+    }
+
+    template<class... Args>
+    std::pair<size_type, bool> emplace_impl(Args &&... args) {
+        value_type value(std::forward<Args>(args)...);
+        return emplace_unique(value.first, std::move(value));
+    }
+
+    template<class A, class B>
+    std::pair<size_type, bool> emplace_impl(A &&key, B &&mapped) {
+        if constexpr (is_key<A>) {
+            return emplace_unique(key, std::forward<A>(key), std::forward<B>(mapped));
+        } else {
+            value_type value(std::forward<A>(key), std::forward<B>(mapped));
+            return emplace_unique(value.first, std::move(value));
+        }
+    }
+};
@@ -1,15 +1,250 @@
 #pragma once
 
+#include "group.h"
 #include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// A collision policy yields the next probe position and the group of control bytes
+// inspected at each position. Positions are wrapped with a single subtraction instead of
+// a division: a step never exceeds the table size since probe loops are bounded by it.
+// A policy setting backward_shift erases by moving the rest of the cluster back instead
+// of leaving a tombstone, which is only valid for slot by slot linear probing.
+// next() is constexpr, so that tables built at compile time probe the same way.
 
 struct LinearProbing {
-    static size_t next(size_t curr, size_t, size_t size) {
-        return (curr + 1) % size;
+    using group_type = ScalarGroup;
+
+    static constexpr bool backward_shift = true;
+
+    static constexpr size_t next(size_t curr, size_t, size_t size) {
+        return curr + 1 < size ? curr + 1 : curr + 1 - size;
     }
 };
 
+// Triangular numbers as offsets, which visit every slot of a power of two sized table only:
+// with other capacities some slots are never probed, so power_of_two asks for a growth
+// policy producing power of two capacities.
 struct QuadraticProbing {
-    static size_t next(size_t curr, size_t step_num, size_t size) {
-        return (curr + step_num * step_num) % size;
+    using group_type = ScalarGroup;
+
+    static constexpr bool backward_shift = false;
+    static constexpr bool power_of_two = true;
+
+    static constexpr size_t next(size_t curr, size_t step_num, size_t size) {
+        return curr + step_num < size ? curr + step_num : curr + step_num - size;
+    }
+};
+
+// Linear probing over whole groups of 16 (SSE2) or 32 (AVX2) control bytes;
+// Equal is called only for slots whose 7-bit hash tag matches.
+struct GroupProbing {
+    using group_type = SimdGroup;
+
+    static constexpr bool backward_shift = false;
+
+    static constexpr size_t next(size_t curr, size_t, size_t size) {
+        return curr + group_type::width < size ? curr + group_type::width : curr + group_type::width - size;
+    }
+};
+
+// Linear probing which keeps every cluster ordered by home slot: an element being inserted
+// takes the place of the first one closer to its home, and a lookup stops as soon as it has
+// probed further than the element in the current slot. Probe lengths above max_distance
+// make the table grow.
+struct RobinHoodProbing {
+    using group_type = ScalarGroup;
+
+    static constexpr bool backward_shift = true;
+    static constexpr bool robin_hood = true;
+    static constexpr size_t max_distance = 64;
+
+    static constexpr size_t next(size_t curr, size_t, size_t size) {
+        return curr + 1 < size ? curr + 1 : curr + 1 - size;
+    }
+};
+
+template<class Policy, class = void>
+struct erases_by_backward_shift : std::false_type {
+};
+
+template<class Policy>
+struct erases_by_backward_shift<Policy, std::void_t<decltype(Policy::backward_shift)>>
+        : std::integral_constant<bool, Policy::backward_shift> {
+};
+
+template<class Policy, class = void>
+struct needs_power_of_two : std::false_type {
+};
+
+template<class Policy>
+struct needs_power_of_two<Policy, std::void_t<decltype(Policy::power_of_two)>>
+        : std::integral_constant<bool, Policy::power_of_two> {
+};
+
+template<class Policy, class = void>
+struct is_robin_hood : std::false_type {
+};
+
+template<class Policy>
+struct is_robin_hood<Policy, std::void_t<decltype(Policy::robin_hood)>>
+        : std::integral_constant<bool, Policy::robin_hood> {
+};
+
+// Wraps a collision policy to drop the links keeping the insertion order, two indices per slot:
+// iterators walk the slot array instead, skipping free slots a SIMD group of control bytes at
+// a time, so a full scan reads memory sequentially. The iteration order is then the slot order,
+// which a rehash changes, and insertion hints are ignored. Erase leaves a tombstone even with
+// linear probing, so that erasing while iterating never moves an element across the iterator.
+template<class Policy>
+struct SlotOrder : Policy {
+    static_assert(!is_robin_hood<Policy>::value, "robin hood tables move elements on erase");
+
+    static constexpr bool backward_shift = false;
+    static constexpr bool slot_order = true;
+};
+
+template<class Policy, class = void>
+struct is_slot_ordered : std::false_type {
+};
+
+template<class Policy>
+struct is_slot_ordered<Policy, std::void_t<decltype(Policy::slot_order)>>
+        : std::integral_constant<bool, Policy::slot_order> {
+};
+
+// A reducer maps a hash to the home slot of a table of the given capacity.
+// Reducers with power_of_two set make the table round its capacity up to a power of two.
+
+// Takes the low bits of the hash; only suitable for hashers which mix their output.
+struct MaskReducer {
+    static constexpr bool power_of_two = true;
+
+    static size_t index(size_t hash, size_t capacity) {
+        return hash & (capacity - 1);
     }
 };
+
+// Multiplies by 2^64 / phi and takes the high bits, so sequential keys hashed by the
+// identity (std::hash<int>) are spread over the whole table.
+struct FibonacciReducer {
+    static constexpr bool power_of_two = true;
+
+    static size_t index(size_t hash, size_t capacity) {
+        return static_cast<size_t>((static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ULL)
+                >> (64 - count_trailing_zeros(capacity)));
+    }
+};
+
+// Lemire's fast range for arbitrary capacities: the product of a 64-bit value and the
+// capacity, shifted right by 64. The hash is scrambled first since only its high bits count.
+struct FastRangeReducer {
+    static constexpr bool power_of_two = false;
+
+    static size_t index(size_t hash, size_t capacity) {
+        std::uint64_t h = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+#if defined(__SIZEOF_INT128__)
+        __extension__ using uint128 = unsigned __int128;
+        return static_cast<size_t>((static_cast<uint128>(h) * capacity) >> 64);
+#else
+        return static_cast<size_t>(((h >> 32) * static_cast<std::uint64_t>(capacity)) >> 32);
+#endif
+    }
+};
+
+// Plain modulo, the classic companion of prime capacities.
+struct ModuloReducer {
+    static constexpr bool power_of_two = false;
+
+    static size_t index(size_t hash, size_t capacity) {
+        return hash % capacity;
+    }
+};
+
+// A growth policy picks the capacity a full table grows to and rounds requested capacities
+// up to the ones it produces. Policies without power_of_two need a reducer without it too.
+
+struct DoublingGrowth {
+    static constexpr bool power_of_two = true;
+
+    static size_t fit(size_t capacity) {
+        size_t res = 1;
+        while (res < capacity) {
+            res <<= 1;
+        }
+        return res;
+    }
+
+    static size_t next(size_t capacity) {
+        return capacity * 2;
+    }
+};
+
+// Grows by half of the capacity, which lets memory freed by previous arrays be reused.
+struct OneAndHalfGrowth {
+    static constexpr bool power_of_two = false;
+
+    static size_t fit(size_t capacity) {
+        return capacity;
+    }
+
+    static size_t next(size_t capacity) {
+        return capacity + capacity / 2;
+    }
+};
+
+// Roughly doubles keeping the capacity prime, so that ModuloReducer uses every bit of the hash.
+struct PrimeGrowth {
+    static constexpr bool power_of_two = false;
+
+    static size_t fit(size_t capacity) {
+        if (capacity <= 2) {
+            return 2;
+        }
+        size_t res = capacity | 1;
+        while (!is_prime(res)) {
+            res += 2;
+        }
+        return res;
+    }
+
+    static size_t next(size_t capacity) {
+        return fit(capacity * 2);
+    }
+
+private:
+    static bool is_prime(size_t n) {
+        if (n % 3 == 0) {
+            return n == 3;
+        }
+        for (size_t d = 5; d <= n / d; d += 6) {
+            if (n % d == 0 || n % (d + 2) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Wraps a growth policy to resize incrementally: a table outgrowing its arrays allocates the
+// new ones but leaves the elements where they are, then every insert or erase moves up to Step
+// of them, so no single operation pays for moving the whole table. Lookups missing the new
+// arrays probe the old ones until they are empty.
+template<class Growth, size_t Step = 8>
+struct IncrementalGrowth : Growth {
+    // the old arrays must empty before the new ones fill up, which takes two moves per insert
+    // when growing by half
+    static_assert(Step >= 2, "at least two elements must be moved per operation");
+
+    static constexpr bool incremental = true;
+    static constexpr size_t migration_step = Step;
+};
+
+template<class Policy, class = void>
+struct is_incremental : std::false_type {
+};
+
+template<class Policy>
+struct is_incremental<Policy, std::void_t<decltype(Policy::incremental)>>
+        : std::integral_constant<bool, Policy::incremental> {
+};
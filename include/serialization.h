@@ -0,0 +1,450 @@
+#pragma once
+
+#include "hash_map.h"
+#include "hash_set.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+// Streaming binary serialization of HashMap and HashSet. Elements are encoded one at a time by
+// codecs into a fixed size buffer and decoded straight into the table being loaded, so neither
+// side ever holds a second copy of the data. A codec for T has
+//     void write(StreamWriter &, const T &) const;
+//     T read(StreamReader &) const;
+// Codec<T> covers trivially copyable types, strings, vectors and pairs of those; specialize it
+// or pass codec objects to save/load for other types.
+//
+// The slot of every element is saved along with it. When the table is loaded with the same
+// hasher and policies the elements are put straight into their slots without probing, otherwise
+// they are inserted as usual into a table reserved for all of them. Encoded values have the byte
+// order of the host.
+
+class StreamWriter {
+public:
+    static constexpr std::size_t chunk_size = 1 << 16;
+
+    explicit StreamWriter(std::ostream &out) : m_out(out), m_buffer(new char[chunk_size]) {}
+
+    void write(const void *data, std::size_t n) {
+        if (n == 0) {
+            return;
+        }
+        if (m_used + n > chunk_size) {
+            flush();
+            if (n >= chunk_size) {
+                put(data, n);
+                return;
+            }
+        }
+        std::memcpy(m_buffer.get() + m_used, data, n);
+        m_used += n;
+    }
+
+    // the buffered bytes are not written on destruction
+    void flush() {
+        put(m_buffer.get(), m_used);
+        m_used = 0;
+    }
+
+private:
+    std::ostream &m_out;
+    std::unique_ptr<char[]> m_buffer;
+    std::size_t m_used = 0;
+
+    void put(const void *data, std::size_t n) {
+        if (!m_out.write(static_cast<const char *>(data), static_cast<std::streamsize>(n))) {
+            throw std::runtime_error("serialization: write failed");
+        }
+    }
+};
+
+// Reads exactly the bytes asked for, so a table may be followed by other data in the stream.
+class StreamReader {
+public:
+    explicit StreamReader(std::istream &in) : m_in(in) {}
+
+    void read(void *data, std::size_t n) {
+        if (!m_in.read(static_cast<char *>(data), static_cast<std::streamsize>(n))) {
+            throw std::runtime_error("serialization: unexpected end of stream");
+        }
+        m_offset += n;
+    }
+
+    // Bytes left in the stream, or the maximum when it cannot seek. The end is found on the
+    // first call only.
+    std::uint64_t remaining() {
+        if (!m_end_known) {
+            m_end = m_offset + stream_left();
+            m_end_known = true;
+        }
+        return m_end - m_offset;
+    }
+
+    // a stored length which cannot fit into the rest of the stream is corrupted
+    void check_length(std::uint64_t count, std::uint64_t item_bytes) {
+        if (item_bytes != 0 && count > remaining() / item_bytes) {
+            throw std::runtime_error("serialization: corrupted length");
+        }
+    }
+
+private:
+    std::istream &m_in;
+    std::uint64_t m_offset = 0;
+    std::uint64_t m_end = 0;
+    bool m_end_known = false;
+
+    std::uint64_t stream_left() {
+        const std::uint64_t unknown = std::numeric_limits<std::uint64_t>::max() - m_offset;
+        const std::istream::pos_type pos = m_in.tellg();
+        if (pos == std::istream::pos_type(-1)) {
+            return unknown;
+        }
+        m_in.seekg(0, std::ios::end);
+        const std::istream::pos_type end = m_in.tellg();
+        m_in.clear();
+        m_in.seekg(pos);
+        if (end == std::istream::pos_type(-1) || end < pos) {
+            return unknown;
+        }
+        return static_cast<std::uint64_t>(end - pos);
+    }
+};
+
+template<class T, class = void>
+struct Codec;
+
+template<class T>
+struct is_codec_composite : std::false_type {
+};
+
+template<class A, class B>
+struct is_codec_composite<std::pair<A, B>> : std::true_type {
+};
+
+template<class T>
+struct Codec<T, std::enable_if_t<std::is_trivially_copyable_v<T> && !is_codec_composite<T>::value>> {
+    void write(StreamWriter &out, const T &value) const {
+        out.write(&value, sizeof(T));
+    }
+
+    T read(StreamReader &in) const {
+        T value;
+        in.read(&value, sizeof(T));
+        return value;
+    }
+};
+
+template<class Char, class Traits, class Alloc>
+struct Codec<std::basic_string<Char, Traits, Alloc>> {
+    void write(StreamWriter &out, const std::basic_string<Char, Traits, Alloc> &value) const {
+        const std::uint64_t size = value.size();
+        out.write(&size, sizeof(size));
+        out.write(value.data(), value.size() * sizeof(Char));
+    }
+
+    std::basic_string<Char, Traits, Alloc> read(StreamReader &in) const {
+        std::uint64_t size;
+        in.read(&size, sizeof(size));
+        in.check_length(size, sizeof(Char));
+        std::basic_string<Char, Traits, Alloc> value(static_cast<std::size_t>(size), Char());
+        in.read(value.data(), value.size() * sizeof(Char));
+        return value;
+    }
+};
+
+template<class T, class Alloc>
+struct Codec<std::vector<T, Alloc>> {
+    // std::vector<bool> packs its bits and has no data()
+    static constexpr bool bulk =
+            std::is_trivially_copyable_v<T> && !is_codec_composite<T>::value && !std::is_same_v<T, bool>;
+
+    void write(StreamWriter &out, const std::vector<T, Alloc> &value) const {
+        const std::uint64_t size = value.size();
+        out.write(&size, sizeof(size));
+        if constexpr (bulk) {
+            out.write(value.data(), value.size() * sizeof(T));
+        } else {
+            for (const T &item : value) {
+                Codec<T>().write(out, item);
+            }
+        }
+    }
+
+    std::vector<T, Alloc> read(StreamReader &in) const {
+        std::uint64_t size;
+        in.read(&size, sizeof(size));
+        std::vector<T, Alloc> value;
+        if constexpr (bulk) {
+            in.check_length(size, sizeof(T));
+            value.resize(static_cast<std::size_t>(size));
+            in.read(value.data(), value.size() * sizeof(T));
+        } else {
+            // a codec may encode an item into no byte, so only the reservation is bounded
+            value.reserve(static_cast<std::size_t>(std::min(size, in.remaining())));
+            for (std::uint64_t i = 0; i < size; ++i) {
+                value.push_back(Codec<T>().read(in));
+            }
+        }
+        return value;
+    }
+};
+
+template<class A, class B>
+struct Codec<std::pair<A, B>> {
+    void write(StreamWriter &out, const std::pair<A, B> &value) const {
+        Codec<std::remove_const_t<A>>().write(out, value.first);
+        Codec<B>().write(out, value.second);
+    }
+
+    std::pair<A, B> read(StreamReader &in) const {
+        auto first = Codec<std::remove_const_t<A>>().read(in);
+        return std::pair<A, B>(std::move(first), Codec<B>().read(in));
+    }
+};
+
+// access to the tables of the containers
+struct SerializationAccess {
+    template<class Container>
+    static auto &table(Container &container) {
+        return container.m_table;
+    }
+};
+
+namespace serialization {
+
+inline constexpr char magic[8] = {'O', 'A', 'H', 'T', 'S', 'E', 'R', '\0'};
+inline constexpr std::uint32_t format_version = 1;
+
+// elements whose hashes go into Header::hash_check, taken in iteration order
+inline constexpr std::size_t hash_check_keys = 16;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t max_load_factor;
+    std::uint64_t size;
+    std::uint64_t capacity;
+    // number of saved tombstones, npos if the slots are not saved
+    std::uint64_t tombstones;
+    std::uint64_t layout;
+    std::uint64_t hash_check;
+};
+
+inline constexpr std::uint64_t no_layout = static_cast<std::uint64_t>(-1);
+
+inline std::uint64_t mix(std::uint64_t check, std::uint64_t hash) {
+    return (check ^ hash) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Identifies what the slots of an element depend on besides its hash. Type names are compiler
+// specific, a mismatch only means that the elements are inserted as usual.
+template<class Key, class CollisionPolicy, class Hash, class Reducer, class GrowthPolicy>
+std::uint64_t layout_id() {
+    const char *name = typeid(std::tuple<Key, CollisionPolicy, Hash, Reducer, GrowthPolicy>).name();
+    std::uint64_t id = 0xCBF29CE484222325ULL;
+    for (; *name != '\0'; ++name) {
+        id = (id ^ static_cast<unsigned char>(*name)) * 0x100000001B3ULL;
+    }
+    return mix(id, CollisionPolicy::group_type::width);
+}
+
+template<class T>
+void write_raw(StreamWriter &out, const T &value) {
+    out.write(&value, sizeof(value));
+}
+
+template<class T>
+T read_raw(StreamReader &in) {
+    T value;
+    in.read(&value, sizeof(value));
+    return value;
+}
+
+inline void write_header(StreamWriter &out, const Header &header) {
+    out.write(header.magic, sizeof(header.magic));
+    write_raw(out, header.version);
+    write_raw(out, header.max_load_factor);
+    write_raw(out, header.size);
+    write_raw(out, header.capacity);
+    write_raw(out, header.tombstones);
+    write_raw(out, header.layout);
+    write_raw(out, header.hash_check);
+}
+
+inline Header read_header(StreamReader &in) {
+    Header header;
+    in.read(header.magic, sizeof(header.magic));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("serialization: not a serialized table");
+    }
+    header.version = read_raw<std::uint32_t>(in);
+    if (header.version != format_version) {
+        throw std::runtime_error("serialization: unsupported version");
+    }
+    header.max_load_factor = read_raw<std::uint32_t>(in);
+    header.size = read_raw<std::uint64_t>(in);
+    header.capacity = read_raw<std::uint64_t>(in);
+    header.tombstones = read_raw<std::uint64_t>(in);
+    header.layout = read_raw<std::uint64_t>(in);
+    header.hash_check = read_raw<std::uint64_t>(in);
+    return header;
+}
+
+// key_of(value) gives the key of an element, write_value(out, value) encodes it
+template<class Table, class KeyOf, class WriteValue>
+void save_table(std::ostream &stream, const Table &table, std::uint64_t layout, KeyOf key_of, WriteValue write_value) {
+    StreamWriter out(stream);
+    // slots of an incremental resize in progress span two arrays and cannot be restored
+    const bool slots = !table.migrating();
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = format_version;
+    const float max_load = table.max_load_factor();
+    std::memcpy(&header.max_load_factor, &max_load, sizeof(max_load));
+    header.size = table.size();
+    header.capacity = table.capacity();
+    header.tombstones = slots ? table.tombstones() : no_layout;
+    header.layout = layout;
+    std::size_t taken = 0;
+    for (auto it = table.begin(); it != table.end() && taken < hash_check_keys; ++it, ++taken) {
+        header.hash_check = mix(header.hash_check, table.hash_function()(key_of(*it)));
+    }
+    write_header(out, header);
+    if (slots) {
+        table.for_each_tombstone([&out](std::size_t idx) {
+            write_raw<std::uint64_t>(out, idx);
+        });
+    }
+    for (auto it = table.begin(); it != table.end(); ++it) {
+        if (slots) {
+            write_raw<std::uint64_t>(out, it.index());
+        }
+        write_value(out, *it);
+    }
+    out.flush();
+}
+
+// read_element(in) decodes an element as a tuple of its key and the arguments constructing it
+template<class Table, class ReadElement>
+void load_table(std::istream &stream, Table &table, std::uint64_t layout, ReadElement read_element) {
+    StreamReader in(stream);
+    const Header header = read_header(in);
+    float max_load;
+    std::memcpy(&max_load, &header.max_load_factor, sizeof(max_load));
+    if (!(max_load > 0.0f && max_load < 1.0f)) {
+        throw std::runtime_error("serialization: corrupted header");
+    }
+    table.clear();
+    table.max_load_factor(max_load);
+    const bool slots = header.tombstones != no_layout;
+    bool restoring = slots && header.layout == layout && header.capacity > header.size &&
+                     table.restore_layout(static_cast<std::size_t>(header.capacity));
+    if (slots) {
+        for (std::uint64_t i = 0; i < header.tombstones; ++i) {
+            const auto idx = read_raw<std::uint64_t>(in);
+            if (restoring && !table.restore_tombstone(static_cast<std::size_t>(idx))) {
+                throw std::runtime_error("serialization: corrupted slots");
+            }
+        }
+    }
+    if (!restoring) {
+        table.clear();
+        table.rehash(static_cast<std::size_t>(header.size));
+    }
+    std::uint64_t hash_check = 0;
+    for (std::uint64_t i = 0; i < header.size; ++i) {
+        const std::uint64_t idx = slots ? read_raw<std::uint64_t>(in) : 0;
+        auto element = read_element(in);
+        const std::size_t hash = table.hash_function()(std::get<0>(element));
+        if (restoring) {
+            if (i < hash_check_keys) {
+                hash_check = mix(hash_check, hash);
+            }
+            const bool placed = std::apply([&](auto &... args) {
+                return table.restore_at(static_cast<std::size_t>(idx), hash, std::move(args)...);
+            }, element);
+            if (!placed) {
+                throw std::runtime_error("serialization: corrupted slots");
+            }
+            if (i + 1 == std::min<std::uint64_t>(header.size, hash_check_keys) && hash_check != header.hash_check) {
+                // another hasher, the slots restored so far are wrong
+                table.rebuild();
+                restoring = false;
+            }
+        } else {
+            std::apply([&](auto &key, auto &... args) {
+                table.emplace_with_hash(Table::npos, key, hash, std::move(key), std::move(args)...);
+            }, element);
+        }
+    }
+}
+
+} // namespace serialization
+
+template<class Key, class T, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy,
+        class Allocator, class KeyCodec = Codec<Key>, class MappedCodec = Codec<T>>
+void save(std::ostream &out,
+          const HashMap<Key, T, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &map,
+          KeyCodec key_codec = KeyCodec(),
+          MappedCodec mapped_codec = MappedCodec()) {
+    serialization::save_table(out, SerializationAccess::table(map),
+                              serialization::layout_id<Key, CollisionPolicy, Hash, Reducer, GrowthPolicy>(),
+                              [](const std::pair<const Key, T> &value) -> const Key & { return value.first; },
+                              [&](StreamWriter &writer, const std::pair<const Key, T> &value) {
+                                  key_codec.write(writer, value.first);
+                                  mapped_codec.write(writer, value.second);
+                              });
+}
+
+// replaces the contents of map with the saved ones, the maximum load factor included
+template<class Key, class T, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy,
+        class Allocator, class KeyCodec = Codec<Key>, class MappedCodec = Codec<T>>
+void load(std::istream &in,
+          HashMap<Key, T, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &map,
+          KeyCodec key_codec = KeyCodec(),
+          MappedCodec mapped_codec = MappedCodec()) {
+    serialization::load_table(in, SerializationAccess::table(map),
+                              serialization::layout_id<Key, CollisionPolicy, Hash, Reducer, GrowthPolicy>(),
+                              [&](StreamReader &reader) {
+                                  Key key = key_codec.read(reader);
+                                  T mapped = mapped_codec.read(reader);
+                                  return std::make_tuple(std::move(key), std::move(mapped));
+                              });
+}
+
+template<class Key, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy,
+        class Allocator, class KeyCodec = Codec<Key>>
+void save(std::ostream &out,
+          const HashSet<Key, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &set,
+          KeyCodec key_codec = KeyCodec()) {
+    serialization::save_table(out, SerializationAccess::table(set),
+                              serialization::layout_id<Key, CollisionPolicy, Hash, Reducer, GrowthPolicy>(),
+                              [](const Key &key) -> const Key & { return key; },
+                              [&](StreamWriter &writer, const Key &key) {
+                                  key_codec.write(writer, key);
+                              });
+}
+
+template<class Key, class CollisionPolicy, class Hash, class Equal, class Reducer, class GrowthPolicy,
+        class Allocator, class KeyCodec = Codec<Key>>
+void load(std::istream &in,
+          HashSet<Key, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator> &set,
+          KeyCodec key_codec = KeyCodec()) {
+    serialization::load_table(in, SerializationAccess::table(set),
+                              serialization::layout_id<Key, CollisionPolicy, Hash, Reducer, GrowthPolicy>(),
+                              [&](StreamReader &reader) {
+                                  return std::make_tuple(key_codec.read(reader));
+                              });
+}
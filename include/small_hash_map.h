@@ -0,0 +1,280 @@
+#pragma once
+
+#include "hash_map.h"
+#include "policy.h"
+#include "small_table.h"
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A HashMap keeping up to N elements inline, without any allocation, see SmallTable.
+// Iterators and references are invalidated by every insert and erase while the elements are
+// inline, and by the insert moving them to the table.
+template<
+        class Key,
+        class T,
+        std::size_t N = 8,
+        class CollisionPolicy = LinearProbing,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<std::pair<const Key, T>>
+>
+class SmallHashMap {
+
+    struct KeyOf {
+        static const Key &get(const std::pair<const Key, T> &value) {
+            return value.first;
+        }
+    };
+
+    using Large = HashMap<Key, T, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator>;
+
+    using Table = SmallTable<std::pair<const Key, T>, KeyOf, Large, N>;
+
+public:
+    // types
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = typename Large::hasher;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+
+    using iterator = typename Table::iterator;
+    using const_iterator = typename Table::const_iterator;
+
+    static constexpr size_type inline_capacity = N;
+
+    explicit SmallHashMap(const hasher &hash = hasher(),
+                          const key_equal &equal = key_equal(),
+                          const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {}
+
+    explicit SmallHashMap(const allocator_type &alloc) : SmallHashMap(hasher(), key_equal(), alloc) {}
+
+    template<class InputIt>
+    SmallHashMap(InputIt first, InputIt last,
+                 const hasher &hash = hasher(),
+                 const key_equal &equal = key_equal(),
+                 const allocator_type &alloc = allocator_type()) : SmallHashMap(hash, equal, alloc) {
+        insert(first, last);
+    }
+
+    SmallHashMap(std::initializer_list<value_type> init,
+                 const hasher &hash = hasher(),
+                 const key_equal &equal = key_equal(),
+                 const allocator_type &alloc = allocator_type())
+            : SmallHashMap(init.begin(), init.end(), hash, equal, alloc) {}
+
+    SmallHashMap &operator=(std::initializer_list<value_type> init) {
+        clear();
+        insert(init);
+        return *this;
+    }
+
+    iterator begin() noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator begin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator cbegin() const noexcept {
+        return m_table.begin();
+    }
+
+    iterator end() noexcept {
+        return m_table.end();
+    }
+
+    const_iterator end() const noexcept {
+        return m_table.end();
+    }
+
+    const_iterator cend() const noexcept {
+        return m_table.end();
+    }
+
+    bool empty() const {
+        return m_table.size() == 0;
+    }
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
+    }
+
+    // whether the elements are still stored inline
+    bool is_inline() const {
+        return m_table.is_inline();
+    }
+
+    void clear() {
+        m_table.clear();
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        return m_table.emplace_unique(value.first, value);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value) {
+        return m_table.emplace_unique(value.first, std::move(value));
+    }
+
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (auto it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    void insert(std::initializer_list<value_type> init) {
+        insert(init.begin(), init.end());
+    }
+
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&value) {
+        return assign_impl(key, std::forward<M>(value));
+    }
+
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&value) {
+        return assign_impl(std::move(key), std::forward<M>(value));
+    }
+
+    // the key is looked up before anything is constructed when the arguments are a key and
+    // a mapped value, otherwise the element is built first
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    template<class A, class B>
+    std::pair<iterator, bool> emplace(A &&key, B &&mapped) {
+        if constexpr (std::is_same_v<std::remove_cv_t<std::remove_reference_t<A>>, Key>) {
+            return m_table.emplace_unique(key, std::forward<A>(key), std::forward<B>(mapped));
+        } else {
+            return insert(value_type(std::forward<A>(key), std::forward<B>(mapped)));
+        }
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const key_type &key, Args &&... args) {
+        return try_emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(key_type &&key, Args &&... args) {
+        return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    iterator erase(const_iterator pos) {
+        return m_table.erase(pos);
+    }
+
+    size_type erase(const key_type &key) {
+        return m_table.erase_key(key);
+    }
+
+    void swap(SmallHashMap &other) {
+        m_table.swap(other.m_table);
+    }
+
+    size_type count(const key_type &key) const {
+        return m_table.contains(key) ? 1 : 0;
+    }
+
+    iterator find(const key_type &key) {
+        return m_table.find(key);
+    }
+
+    const_iterator find(const key_type &key) const {
+        return m_table.find(key);
+    }
+
+    bool contains(const key_type &key) const {
+        return m_table.contains(key);
+    }
+
+    mapped_type &at(const key_type &key) {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("SmallHashMap::at");
+        }
+        return it->second;
+    }
+
+    const mapped_type &at(const key_type &key) const {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("SmallHashMap::at");
+        }
+        return it->second;
+    }
+
+    mapped_type &operator[](const key_type &key) {
+        return try_emplace(key).first->second;
+    }
+
+    mapped_type &operator[](key_type &&key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    // moves the elements to the table right away when count does not fit inline
+    void reserve(size_type count) {
+        m_table.reserve(count);
+    }
+
+    // compare two containers contents
+    friend bool operator==(const SmallHashMap &lhs, const SmallHashMap &rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (const auto &value : lhs) {
+            auto el = rhs.find(value.first);
+            if (el == rhs.end() || !(value.second == el->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const SmallHashMap &lhs, const SmallHashMap &rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    Table m_table;
+
+    template<class K, class... Args>
+    std::pair<iterator, bool> try_emplace_impl(K &&key, Args &&... args) {
+        return m_table.emplace_unique(key,
+                                      std::piecewise_construct,
+                                      std::forward_as_tuple(std::forward<K>(key)),
+                                      std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class K, class M>
+    std::pair<iterator, bool> assign_impl(K &&key, M &&value) {
+        auto res = m_table.emplace_unique(key, std::forward<K>(key), std::forward<M>(value));
+        if (!res.second) {
+            res.first->second = std::forward<M>(value);
+        }
+        return res;
+    }
+};
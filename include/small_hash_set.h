@@ -0,0 +1,201 @@
+#pragma once
+
+#include "hash_set.h"
+#include "policy.h"
+#include "small_table.h"
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// A HashSet keeping up to N elements inline, without any allocation, see SmallTable.
+// Iterators and references are invalidated by every insert and erase while the elements are
+// inline, and by the insert moving them to the table.
+template<
+        class Key,
+        std::size_t N = 8,
+        class CollisionPolicy = LinearProbing,
+        class Hash = std::hash<Key>,
+        class Equal = std::equal_to<Key>,
+        class Reducer = FibonacciReducer,
+        class GrowthPolicy = DoublingGrowth,
+        class Allocator = std::allocator<Key>
+>
+class SmallHashSet {
+
+    struct KeyOf {
+        static const Key &get(const Key &value) {
+            return value;
+        }
+    };
+
+    using Large = HashSet<Key, CollisionPolicy, Hash, Equal, Reducer, GrowthPolicy, Allocator>;
+
+    using Table = SmallTable<Key, KeyOf, Large, N>;
+
+public:
+    // types
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = typename Large::hasher;
+    using key_equal = Equal;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+
+    using iterator = typename Table::const_iterator;
+    using const_iterator = typename Table::const_iterator;
+
+    static constexpr size_type inline_capacity = N;
+
+    explicit SmallHashSet(const hasher &hash = hasher(),
+                          const key_equal &equal = key_equal(),
+                          const allocator_type &alloc = allocator_type()) : m_table(hash, equal, alloc) {}
+
+    explicit SmallHashSet(const allocator_type &alloc) : SmallHashSet(hasher(), key_equal(), alloc) {}
+
+    template<class InputIt>
+    SmallHashSet(InputIt first, InputIt last,
+                 const hasher &hash = hasher(),
+                 const key_equal &equal = key_equal(),
+                 const allocator_type &alloc = allocator_type()) : SmallHashSet(hash, equal, alloc) {
+        insert(first, last);
+    }
+
+    SmallHashSet(std::initializer_list<value_type> init,
+                 const hasher &hash = hasher(),
+                 const key_equal &equal = key_equal(),
+                 const allocator_type &alloc = allocator_type())
+            : SmallHashSet(init.begin(), init.end(), hash, equal, alloc) {}
+
+    SmallHashSet &operator=(std::initializer_list<value_type> init) {
+        clear();
+        insert(init);
+        return *this;
+    }
+
+    iterator begin() const noexcept {
+        return m_table.begin();
+    }
+
+    const_iterator cbegin() const noexcept {
+        return m_table.begin();
+    }
+
+    iterator end() const noexcept {
+        return m_table.end();
+    }
+
+    const_iterator cend() const noexcept {
+        return m_table.end();
+    }
+
+    bool empty() const {
+        return m_table.size() == 0;
+    }
+
+    size_type size() const {
+        return m_table.size();
+    }
+
+    allocator_type get_allocator() const {
+        return m_table.get_allocator();
+    }
+
+    // whether the elements are still stored inline
+    bool is_inline() const {
+        return m_table.is_inline();
+    }
+
+    void clear() {
+        m_table.clear();
+    }
+
+    std::pair<iterator, bool> insert(const value_type &key) {
+        return m_table.emplace_unique(key, key);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&key) {
+        return m_table.emplace_unique(key, std::move(key));
+    }
+
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (auto it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    void insert(std::initializer_list<value_type> init) {
+        insert(init.begin(), init.end());
+    }
+
+    // a single key_type argument is looked up as is, others are used to build the key first
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    template<class A>
+    std::pair<iterator, bool> emplace(A &&arg) {
+        if constexpr (std::is_same_v<std::remove_cv_t<std::remove_reference_t<A>>, Key>) {
+            return m_table.emplace_unique(arg, std::forward<A>(arg));
+        } else {
+            return insert(value_type(std::forward<A>(arg)));
+        }
+    }
+
+    iterator erase(const_iterator pos) {
+        return m_table.erase(pos);
+    }
+
+    size_type erase(const key_type &key) {
+        return m_table.erase_key(key);
+    }
+
+    void swap(SmallHashSet &other) {
+        m_table.swap(other.m_table);
+    }
+
+    size_type count(const key_type &key) const {
+        return m_table.contains(key) ? 1 : 0;
+    }
+
+    const_iterator find(const key_type &key) const {
+        return m_table.find(key);
+    }
+
+    bool contains(const key_type &key) const {
+        return m_table.contains(key);
+    }
+
+    // moves the elements to the table right away when count does not fit inline
+    void reserve(size_type count) {
+        m_table.reserve(count);
+    }
+
+    // compare two containers contents
+    friend bool operator==(const SmallHashSet &lhs, const SmallHashSet &rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (const auto &key : lhs) {
+            if (!rhs.contains(key)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const SmallHashSet &lhs, const SmallHashSet &rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    Table m_table;
+};
@@ -0,0 +1,385 @@
+#pragma once
+
+#include "group.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Inline storage for up to N elements in front of a regular container, Large, which takes them
+// over when one more is inserted. The inline elements are kept in insertion order next to the
+// 7-bit tags of their hashes, which a lookup compares a PortableGroup (eight tags) at a time
+// before calling Equal. Large is constructed without any slot, so a table which never outgrows
+// N allocates nothing; once promoted it stays in Large, even when emptied.
+// KeyOf::get gives the key of a value, as for HashTable.
+template<class Value, class KeyOf, class Large, std::size_t N>
+class SmallTable {
+    static_assert(N > 0, "a small table holds at least one element inline");
+
+    static constexpr std::size_t tag_bytes = (N + PortableGroup::width - 1) / PortableGroup::width * PortableGroup::width;
+
+    using large_iterator = typename Large::iterator;
+    using large_const_iterator = typename Large::const_iterator;
+
+    // sets only give const access to their elements
+    static constexpr bool const_values = std::is_same_v<large_iterator, large_const_iterator>;
+
+    // the inline elements are moved one by one, and the key of a map element is copied
+    static constexpr bool nothrow_move_construct =
+            std::is_nothrow_move_constructible_v<Value> && std::is_nothrow_move_constructible_v<Large> &&
+            std::is_nothrow_copy_constructible_v<typename Large::hasher> &&
+            std::is_nothrow_copy_constructible_v<typename Large::key_equal>;
+    static constexpr bool nothrow_move_assign =
+            std::is_nothrow_move_constructible_v<Value> && std::is_nothrow_move_assignable_v<Large> &&
+            std::is_nothrow_copy_assignable_v<typename Large::hasher> &&
+            std::is_nothrow_copy_assignable_v<typename Large::key_equal>;
+    // Large has room for all the elements by then, so only the hasher and key_equal may throw
+    static constexpr bool nothrow_promote =
+            std::is_nothrow_move_constructible_v<Value> &&
+            noexcept(std::declval<const typename Large::hasher &>()(std::declval<const typename Large::key_type &>())) &&
+            noexcept(std::declval<const typename Large::key_equal &>()(
+                    std::declval<const typename Large::key_type &>(), std::declval<const typename Large::key_type &>()));
+
+    template<bool Const>
+    class Iterator;
+
+public:
+    using key_type = typename Large::key_type;
+    using value_type = Value;
+    using size_type = std::size_t;
+    using hasher = typename Large::hasher;
+    using key_equal = typename Large::key_equal;
+    using allocator_type = typename Large::allocator_type;
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    static constexpr size_type inline_capacity = N;
+
+    SmallTable(const hasher &hash, const key_equal &equal, const allocator_type &alloc)
+            : m_large(0, hash, equal, alloc), m_hash(hash), m_equal(equal) {
+        std::fill(m_tags, m_tags + tag_bytes, CTRL_EMPTY);
+    }
+
+    SmallTable(const SmallTable &other)
+            : m_large(other.m_large), m_hash(other.m_hash), m_equal(other.m_equal), m_inline(other.m_inline) {
+        std::fill(m_tags, m_tags + tag_bytes, CTRL_EMPTY);
+        try {
+            copy_inline(other);
+        } catch (...) {
+            // no destructor runs for a constructor which throws
+            destroy_inline();
+            throw;
+        }
+    }
+
+    SmallTable(SmallTable &&other) noexcept(nothrow_move_construct)
+            : m_large(std::move(other.m_large)), m_hash(other.m_hash), m_equal(other.m_equal), m_inline(other.m_inline) {
+        std::fill(m_tags, m_tags + tag_bytes, CTRL_EMPTY);
+        try {
+            move_inline(other);
+        } catch (...) {
+            destroy_inline();
+            throw;
+        }
+    }
+
+    SmallTable &operator=(const SmallTable &other) {
+        if (this != &other) {
+            destroy_inline();
+            m_large = other.m_large;
+            m_hash = other.m_hash;
+            m_equal = other.m_equal;
+            m_inline = other.m_inline;
+            copy_inline(other);
+        }
+        return *this;
+    }
+
+    SmallTable &operator=(SmallTable &&other) noexcept(nothrow_move_assign) {
+        if (this != &other) {
+            destroy_inline();
+            m_large = std::move(other.m_large);
+            m_hash = other.m_hash;
+            m_equal = other.m_equal;
+            m_inline = other.m_inline;
+            move_inline(other);
+        }
+        return *this;
+    }
+
+    ~SmallTable() {
+        destroy_inline();
+    }
+
+    // whether the elements are still stored inline
+    bool is_inline() const {
+        return m_inline;
+    }
+
+    size_type size() const {
+        return m_inline ? m_size : m_large.size();
+    }
+
+    allocator_type get_allocator() const {
+        return m_large.get_allocator();
+    }
+
+    iterator begin() {
+        return m_inline ? iterator(data()) : iterator(m_large.begin());
+    }
+
+    const_iterator begin() const {
+        return m_inline ? const_iterator(data()) : const_iterator(m_large.begin());
+    }
+
+    iterator end() {
+        return m_inline ? iterator(data() + m_size) : iterator(m_large.end());
+    }
+
+    const_iterator end() const {
+        return m_inline ? const_iterator(data() + m_size) : const_iterator(m_large.end());
+    }
+
+    void clear() {
+        if (m_inline) {
+            destroy_inline();
+        } else {
+            m_large.clear();
+        }
+    }
+
+    // moves the elements to Large right away when count does not fit inline
+    void reserve(size_type count) {
+        if (count > N && m_inline) {
+            promote(count);
+        } else if (!m_inline) {
+            m_large.reserve(count);
+        }
+    }
+
+    // Constructs a value from args unless key is present. The inline elements are full when
+    // it is absent, so they move to Large, whose emplace takes args then.
+    template<class K, class... Args>
+    std::pair<iterator, bool> emplace_unique(const K &key, Args &&... args) {
+        if (m_inline) {
+            const size_type hash = m_hash(key);
+            const size_type idx = find_inline(key, hash_tag(hash));
+            if (idx != npos) {
+                return {iterator(data() + idx), false};
+            }
+            if (m_size < N) {
+                new(data() + m_size) Value(std::forward<Args>(args)...);
+                m_tags[m_size] = hash_tag(hash);
+                return {iterator(data() + m_size++), true};
+            }
+            promote(N + 1);
+        }
+        auto res = m_large.emplace(std::forward<Args>(args)...);
+        return {iterator(res.first), res.second};
+    }
+
+    template<class K>
+    iterator find(const K &key) {
+        if (m_inline) {
+            const size_type idx = find_inline(key, hash_tag(m_hash(key)));
+            return iterator(data() + (idx == npos ? m_size : idx));
+        }
+        return iterator(m_large.find(key));
+    }
+
+    template<class K>
+    const_iterator find(const K &key) const {
+        if (m_inline) {
+            const size_type idx = find_inline(key, hash_tag(m_hash(key)));
+            return const_iterator(data() + (idx == npos ? m_size : idx));
+        }
+        return const_iterator(m_large.find(key));
+    }
+
+    template<class K>
+    bool contains(const K &key) const {
+        return m_inline ? find_inline(key, hash_tag(m_hash(key))) != npos : m_large.contains(key);
+    }
+
+    // the inline elements after pos move one place back, so pos then points to the next one
+    iterator erase(const_iterator pos) {
+        if (m_inline) {
+            erase_inline(static_cast<size_type>(pos.m_ptr - data()));
+            return iterator(const_cast<Value *>(pos.m_ptr));
+        }
+        return iterator(m_large.erase(pos.m_it));
+    }
+
+    template<class K>
+    size_type erase_key(const K &key) {
+        if (m_inline) {
+            const size_type idx = find_inline(key, hash_tag(m_hash(key)));
+            if (idx == npos) {
+                return 0;
+            }
+            erase_inline(idx);
+            return 1;
+        }
+        return m_large.erase(key);
+    }
+
+    void swap(SmallTable &other) {
+        std::swap(*this, other);
+    }
+
+private:
+    Large m_large;
+    hasher m_hash;
+    key_equal m_equal;
+    size_type m_size = 0;
+    bool m_inline = true;
+    // tags of the inline elements, CTRL_EMPTY past them, which no tag matches
+    ctrl_t m_tags[tag_bytes];
+    alignas(Value) unsigned char m_storage[N * sizeof(Value)];
+
+    template<bool Const>
+    class Iterator {
+        friend class SmallTable;
+
+        friend class Iterator<!Const>;
+
+        static constexpr bool const_access = Const || const_values;
+
+        using value_pointer = std::conditional_t<const_access, const Value *, Value *>;
+        using base_iterator = std::conditional_t<Const, large_const_iterator, large_iterator>;
+
+        // inline elements are pointed to directly, the others through an iterator of Large
+        value_pointer m_ptr = nullptr;
+        base_iterator m_it;
+
+        explicit Iterator(value_pointer ptr) : m_ptr(ptr) {}
+
+        explicit Iterator(base_iterator it) : m_it(it) {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = value_pointer;
+        using reference = std::conditional_t<const_access, const Value &, Value &>;
+
+        Iterator() = default;
+
+        template<bool C = Const, class = std::enable_if_t<C>>
+        Iterator(const Iterator<false> &it) : m_ptr(it.m_ptr), m_it(it.m_it) {}
+
+        Iterator &operator++() {
+            if (m_ptr != nullptr) {
+                ++m_ptr;
+            } else {
+                ++m_it;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        reference operator*() const {
+            return m_ptr != nullptr ? *m_ptr : *m_it;
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        friend bool operator==(const Iterator &l, const Iterator &r) {
+            return l.m_ptr == r.m_ptr && l.m_it == r.m_it;
+        }
+
+        friend bool operator!=(const Iterator &l, const Iterator &r) {
+            return !(l == r);
+        }
+    };
+
+    Value *data() {
+        return std::launder(reinterpret_cast<Value *>(m_storage));
+    }
+
+    const Value *data() const {
+        return std::launder(reinterpret_cast<const Value *>(m_storage));
+    }
+
+    template<class K>
+    size_type find_inline(const K &key, ctrl_t tag) const {
+        for (size_type g = 0; g < m_size; g += PortableGroup::width) {
+            for (unsigned i : PortableGroup(m_tags + g).match(tag)) {
+                if (m_equal(KeyOf::get(data()[g + i]), key)) {
+                    return g + i;
+                }
+            }
+        }
+        return npos;
+    }
+
+    void erase_inline(size_type idx) {
+        Value *values = data();
+        values[idx].~Value();
+        for (size_type i = idx + 1; i < m_size; ++i) {
+            new(values + i - 1) Value(std::move(values[i]));
+            values[i].~Value();
+            m_tags[i - 1] = m_tags[i];
+        }
+        m_tags[--m_size] = CTRL_EMPTY;
+    }
+
+    // moves the inline elements, in their order, to Large sized for count elements
+    // The elements are moved only when no insertion can throw after the first move, so a
+    // throwing promotion leaves the inline elements as they were.
+    void promote(size_type count) {
+        m_large.reserve(count);
+        Value *values = data();
+        try {
+            for (size_type i = 0; i < m_size; ++i) {
+                if constexpr (nothrow_promote) {
+                    m_large.insert(std::move(values[i]));
+                } else {
+                    m_large.insert(std::as_const(values[i]));
+                }
+            }
+        } catch (...) {
+            m_large.clear();
+            throw;
+        }
+        destroy_inline();
+        m_inline = false;
+    }
+
+    void destroy_inline() {
+        Value *values = data();
+        for (size_type i = 0; i < m_size; ++i) {
+            values[i].~Value();
+        }
+        std::fill(m_tags, m_tags + m_size, CTRL_EMPTY);
+        m_size = 0;
+    }
+
+    void copy_inline(const SmallTable &other) {
+        for (; m_size < other.m_size; ++m_size) {
+            new(data() + m_size) Value(other.data()[m_size]);
+            m_tags[m_size] = other.m_tags[m_size];
+        }
+    }
+
+    // other keeps no element
+    void move_inline(SmallTable &other) {
+        for (; m_size < other.m_size; ++m_size) {
+            new(data() + m_size) Value(std::move(other.data()[m_size]));
+            m_tags[m_size] = other.m_tags[m_size];
+        }
+        other.destroy_inline();
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+// Statistics of a table. They are collected only when OAH_STATS is defined before any container
+// is included, otherwise the containers have no stats() and pay nothing for them. Probe lengths
+// count probe steps: slots for the scalar collision policies, groups for GroupProbing.
+struct TableStats {
+    static constexpr std::size_t histogram_size = 32;
+
+    using histogram = std::array<std::size_t, histogram_size>;
+
+    // probes[i] is the number of probes of length i + 1, the last entry counts the longer ones too
+    histogram hit_probes{};
+    histogram miss_probes{};
+    // probes of inserts up to the free slot found, before any growth they trigger
+    histogram insert_probes{};
+    // clusters[i] is the number of maximal runs of used slots, full or tombstones, whose length
+    // is in [2^i, 2^(i+1))
+    histogram clusters{};
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+    std::size_t tombstones = 0;
+    // inserts which found no free slot at the first probe step
+    std::size_t collisions = 0;
+    std::size_t rehashes = 0;
+    std::chrono::nanoseconds rehash_time{0};
+
+    // the share of used slots, tombstones included, which is what the probe lengths depend on
+    double occupancy() const {
+        return capacity == 0 ? 0.0 : static_cast<double>(size + tombstones) / static_cast<double>(capacity);
+    }
+
+    static double mean_probe(const histogram &probes) {
+        std::size_t count = 0, total = 0;
+        for (std::size_t i = 0; i < histogram_size; ++i) {
+            count += probes[i];
+            total += probes[i] * (i + 1);
+        }
+        return count == 0 ? 0.0 : static_cast<double>(total) / static_cast<double>(count);
+    }
+};
+
+// Counters of a table, relaxed atomics since lookups may run concurrently under a shared lock.
+class StatsCounters {
+public:
+    void lookup(bool hit, std::size_t steps) {
+        add(hit ? m_hit : m_miss, steps);
+    }
+
+    void insert(std::size_t steps) {
+        add(m_insert, steps);
+        if (steps > 1) {
+            m_collisions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void rehash(std::chrono::nanoseconds time) {
+        m_rehashes.fetch_add(1, std::memory_order_relaxed);
+        m_rehash_time.fetch_add(time.count(), std::memory_order_relaxed);
+    }
+
+    void fill(TableStats &stats) const {
+        for (std::size_t i = 0; i < TableStats::histogram_size; ++i) {
+            stats.hit_probes[i] = m_hit[i].load(std::memory_order_relaxed);
+            stats.miss_probes[i] = m_miss[i].load(std::memory_order_relaxed);
+            stats.insert_probes[i] = m_insert[i].load(std::memory_order_relaxed);
+        }
+        stats.collisions = m_collisions.load(std::memory_order_relaxed);
+        stats.rehashes = m_rehashes.load(std::memory_order_relaxed);
+        stats.rehash_time = std::chrono::nanoseconds(m_rehash_time.load(std::memory_order_relaxed));
+    }
+
+    void reset() {
+        for (std::size_t i = 0; i < TableStats::histogram_size; ++i) {
+            m_hit[i].store(0, std::memory_order_relaxed);
+            m_miss[i].store(0, std::memory_order_relaxed);
+            m_insert[i].store(0, std::memory_order_relaxed);
+        }
+        m_collisions.store(0, std::memory_order_relaxed);
+        m_rehashes.store(0, std::memory_order_relaxed);
+        m_rehash_time.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    using counters = std::array<std::atomic<std::size_t>, TableStats::histogram_size>;
+
+    counters m_hit{};
+    counters m_miss{};
+    counters m_insert{};
+    std::atomic<std::size_t> m_collisions{0};
+    std::atomic<std::size_t> m_rehashes{0};
+    std::atomic<std::chrono::nanoseconds::rep> m_rehash_time{0};
+
+    static void add(counters &histogram, std::size_t steps) {
+        const std::size_t bucket = steps == 0 ? 0 : steps - 1;
+        histogram[bucket < TableStats::histogram_size ? bucket : TableStats::histogram_size - 1]
+                .fetch_add(1, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// An executor runs task(i) for every i in [0, count), possibly concurrently, and returns once
+// all of them are done, rethrowing an exception thrown by a task. The parallel operations of
+// the containers accept any callable of that shape, so a thread pool can be plugged in.
+template<class Executor, class = void>
+struct is_executor : std::false_type {
+};
+
+template<class Executor>
+struct is_executor<Executor, std::void_t<decltype(std::declval<Executor &>()(std::size_t(), std::declval<void (*)(std::size_t)>()))>>
+        : std::true_type {
+};
+
+// Runs the tasks on threads started for the call, the calling thread being one of them.
+class ThreadExecutor {
+public:
+    explicit ThreadExecutor(unsigned threads = std::thread::hardware_concurrency())
+            : m_threads(std::max(threads, 1u)) {}
+
+    unsigned concurrency() const {
+        return m_threads;
+    }
+
+    template<class F>
+    void operator()(std::size_t count, F task) const {
+        std::atomic<std::size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto work = [&] {
+            for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+                try {
+                    task(i);
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        const std::size_t extra = std::min<std::size_t>(m_threads, count) - (count > 0 ? 1 : 0);
+        threads.reserve(extra);
+        for (std::size_t i = 0; i < extra; ++i) {
+            try {
+                threads.emplace_back(work);
+            } catch (const std::system_error &) {
+                // the tasks left are run by the threads already started
+                break;
+            }
+        }
+        work();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    unsigned m_threads;
+};
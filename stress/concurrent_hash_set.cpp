@@ -0,0 +1,204 @@
+#include "concurrent_hash_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Readers look up keys which are never erased while a writer churns other keys through
+// insertions and erasures, which keeps migrating the set into new tables. Every lookup of a
+// stable key must succeed, and the keys of retired tables must be released as it goes.
+// Then a migration whose copy throws must be finished by the next writer, and writes made
+// from a cvisit callback must not wait for the callback itself.
+
+namespace {
+
+// counts the live instances, so that retired tables and erased keys can be seen released
+struct Key {
+    static inline std::atomic<std::ptrdiff_t> live{0};
+
+    std::uint64_t value;
+
+    explicit Key(std::uint64_t v) : value(v) {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Key(const Key &other) : value(other.value) {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Key &operator=(const Key &) = default;
+
+    ~Key() {
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool operator==(const Key &other) const {
+        return value == other.value;
+    }
+};
+
+struct KeyHash {
+    std::size_t operator()(const Key &key) const {
+        return static_cast<std::size_t>(hashing::mix64(key.value));
+    }
+};
+
+// copies, which only migrations make, throw once the countdown reaches zero
+struct ThrowingKey {
+    static inline std::atomic<int> copies_left{-1};
+
+    std::uint64_t value;
+
+    explicit ThrowingKey(std::uint64_t v) : value(v) {}
+
+    ThrowingKey(ThrowingKey &&other) noexcept : value(other.value) {}
+
+    ThrowingKey(const ThrowingKey &other) : value(other.value) {
+        if (copies_left.fetch_sub(1, std::memory_order_relaxed) == 0) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+
+    bool operator==(const ThrowingKey &other) const {
+        return value == other.value;
+    }
+};
+
+struct ThrowingKeyHash {
+    std::size_t operator()(const ThrowingKey &key) const {
+        return static_cast<std::size_t>(hashing::mix64(key.value));
+    }
+};
+
+constexpr std::uint64_t stable_keys = 2000;
+constexpr std::uint64_t churn_keys = 1000;
+constexpr std::size_t churn_rounds = 2000;
+constexpr unsigned readers = 3;
+
+int churn_test() {
+    int failed = 0;
+    ConcurrentHashSet<Key, KeyHash> set;
+    for (std::uint64_t i = 0; i < stable_keys; ++i) {
+        set.insert(Key(i));
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> misses{0};
+    std::atomic<std::size_t> lookups{0};
+    std::vector<std::thread> threads;
+    for (unsigned r = 0; r < readers; ++r) {
+        threads.emplace_back([&] {
+            std::size_t local_misses = 0, local_lookups = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                for (std::uint64_t i = 0; i < stable_keys; ++i) {
+                    local_misses += set.contains(Key(i)) ? 0 : 1;
+                }
+                local_lookups += stable_keys;
+            }
+            misses.fetch_add(local_misses);
+            lookups.fetch_add(local_lookups);
+        });
+    }
+    std::ptrdiff_t max_live = 0;
+    for (std::size_t round = 0; round < churn_rounds; ++round) {
+        const std::uint64_t base = stable_keys + round * churn_keys;
+        for (std::uint64_t i = 0; i < churn_keys; ++i) {
+            set.insert(Key(base + i));
+        }
+        for (std::uint64_t i = 0; i < churn_keys; ++i) {
+            set.erase(Key(base + i));
+        }
+        max_live = std::max(max_live, Key::live.load(std::memory_order_relaxed));
+    }
+    done = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (misses.load() != 0) {
+        std::printf("FAILED: %zu of %zu lookups missed a present key\n", misses.load(), lookups.load());
+        failed = 1;
+    }
+    if (set.size() != stable_keys) {
+        std::printf("FAILED: size %zu, expected %zu\n", set.size(), static_cast<std::size_t>(stable_keys));
+        failed = 1;
+    }
+    // the keys of a few tables sized for the live ones, not of every table churned through
+    const std::ptrdiff_t bound = 64 * static_cast<std::ptrdiff_t>(stable_keys + churn_keys);
+    if (max_live > bound) {
+        std::printf("FAILED: %td key instances alive, expected at most %td\n", max_live, bound);
+        failed = 1;
+    }
+    std::printf("%zu lookups, %zu misses, at most %td key instances alive\n", lookups.load(), misses.load(), max_live);
+    return failed;
+}
+
+int throwing_copy_test() {
+    constexpr std::uint64_t keys = 10000;
+    ConcurrentHashSet<ThrowingKey, ThrowingKeyHash> set;
+    std::vector<bool> inserted(keys);
+    std::size_t throws = 0;
+    ThrowingKey::copies_left = 50;
+    for (std::uint64_t i = 0; i < keys / 2; ++i) {
+        try {
+            inserted[i] = set.insert(ThrowingKey(i));
+        } catch (const std::runtime_error &) {
+            ++throws;
+        }
+    }
+    // another thread finishes the migration left behind
+    std::thread writer([&] {
+        for (std::uint64_t i = keys / 2; i < keys; ++i) {
+            inserted[i] = set.insert(ThrowingKey(i));
+        }
+    });
+    writer.join();
+    std::size_t expected = 0, missing = 0;
+    for (std::uint64_t i = 0; i < keys; ++i) {
+        expected += inserted[i] ? 1 : 0;
+        missing += inserted[i] && !set.contains(ThrowingKey(i)) ? 1 : 0;
+    }
+    if (throws != 1 || missing != 0 || set.size() != expected) {
+        std::printf("FAILED: %zu copies threw, %zu keys missing, size %zu of %zu\n", throws, missing, set.size(), expected);
+        return 1;
+    }
+    std::printf("a throwing migration copy was retried, %zu keys present\n", expected);
+    return 0;
+}
+
+int reentrant_write_test() {
+    constexpr std::uint64_t keys = 100000;
+    ConcurrentHashSet<Key, KeyHash> set;
+    set.insert(Key(0));
+    set.cvisit(Key(0), [&](const Key &) {
+        for (std::uint64_t i = 1; i < keys; ++i) {
+            set.insert(Key(i));
+        }
+    });
+    // frees the tables retired by the callback
+    set.erase(Key(0));
+    std::size_t missing = 0;
+    for (std::uint64_t i = 1; i < keys; ++i) {
+        missing += set.contains(Key(i)) ? 0 : 1;
+    }
+    if (missing != 0) {
+        std::printf("FAILED: %zu keys inserted from cvisit are missing\n", missing);
+        return 1;
+    }
+    std::printf("%zu keys inserted from cvisit\n", static_cast<std::size_t>(keys - 1));
+    return 0;
+}
+
+} // namespace
+
+int main() {
+    int failed = churn_test();
+    failed |= throwing_copy_test();
+    failed |= reentrant_write_test();
+    return failed;
+}